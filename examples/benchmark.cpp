@@ -0,0 +1,403 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Times the main paths of the library (parsing, dispatch, writing, a whole request through the server,
+// the client round trip and base64) over payloads from a tiny positional call to arrays of several MB,
+// and counts the allocations each operation makes. Needs nothing but rapidjson; build it optimised:
+//
+//     g++ -O2 -DNDEBUG -std=c++17 -I<rapidjson>/include benchmark.cpp -o benchmark
+//
+// Usage: benchmark [filter] [seconds]
+// Only the benchmarks whose name contains filter are run, each for about seconds (0.5 by default).
+
+#include "../include/jsonrpc-lean/client.h"
+#include "../include/jsonrpc-lean/jsonformathandler.h"
+#include "../include/jsonrpc-lean/jsonreader.h"
+#include "../include/jsonrpc-lean/jsonwriter.h"
+#include "../include/jsonrpc-lean/server.h"
+#include "../include/jsonrpc-lean/staticdispatcher.h"
+#include "../include/jsonrpc-lean/util.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+	std::atomic<size_t> allocationCount(0);
+
+} // namespace
+
+// GCC sees free called on what operator new returned once these are inlined, and warns
+#if defined(__GNUC__)
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define BENCHMARK_NOINLINE
+#endif
+
+// Every allocation of the program goes through here to be counted
+void* operator new(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size != 0 ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+BENCHMARK_NOINLINE void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+namespace {
+
+	typedef std::chrono::steady_clock Clock;
+
+	const char* filter = "";
+	double minimumSeconds = 0.5;
+
+	// Results are added up here, so the work can't be optimised away
+	volatile size_t sink;
+
+	// Runs operation (which returns some size out of its result) until it has taken minimumSeconds, and
+	// prints the time and allocations per call and, given bytes per call, the throughput
+	template<typename OperationType>
+	void Run(const std::string& name, size_t bytes, OperationType operation) {
+		if (name.find(filter) == std::string::npos) {
+			return;
+		}
+
+		sink = sink + operation(); // warm up
+		size_t iterations = 1;
+		for (;;) {
+			const size_t allocationsBefore = allocationCount.load();
+			const auto start = Clock::now();
+			for (size_t i = 0; i < iterations; ++i) {
+				sink = sink + operation();
+			}
+			const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			const size_t allocations = allocationCount.load() - allocationsBefore;
+
+			if (seconds >= minimumSeconds || iterations >= (size_t(1) << 32)) {
+				std::printf("%-40s %10zu %14.1f ns/op %10.1f MB/s %10.1f allocs/op\n", name.c_str(), iterations,
+					seconds * 1e9 / iterations, bytes == 0 ? 0.0 : bytes * iterations / seconds / 1e6,
+					static_cast<double>(allocations) / iterations);
+				return;
+			}
+
+			// aim a bit past the time left, growing at least twofold and at most a hundredfold
+			double factor = seconds > 0 ? minimumSeconds / seconds * 1.2 : 100;
+			factor = factor < 2 ? 2 : factor > 100 ? 100 : factor;
+			iterations = static_cast<size_t>(iterations * factor);
+		}
+	}
+
+	// One request of the corpus: the method it calls and its parameters
+	struct Payload {
+		std::string name;
+		std::string method;
+		jsonrpc::Request::Parameters params;
+	};
+
+	jsonrpc::Value MakeUser(int i) {
+		jsonrpc::Value::Object user;
+		user["id"] = i;
+		user["name"] = "user" + std::to_string(i);
+		user["email"] = "user" + std::to_string(i) + "@example.com";
+		user["active"] = i % 2 == 0;
+		user["score"] = i * 1.25;
+		user["roles"] = jsonrpc::Value::Array{ jsonrpc::Value("reader"), jsonrpc::Value("writer") };
+		jsonrpc::Value::Object address;
+		address["street"] = "Main Street " + std::to_string(i);
+		address["city"] = "Springfield";
+		address["zip"] = "12345";
+		user["address"] = std::move(address);
+		return jsonrpc::Value(std::move(user));
+	}
+
+	jsonrpc::Value MakeNested(int depth) {
+		jsonrpc::Value::Object node;
+		node["depth"] = depth;
+		node["label"] = "level" + std::to_string(depth);
+		if (depth > 0) {
+			node["child"] = MakeNested(depth - 1);
+		}
+		return jsonrpc::Value(std::move(node));
+	}
+
+	std::vector<Payload> MakeCorpus() {
+		std::vector<Payload> corpus;
+
+		corpus.push_back({ "tiny", "add", {} });
+		corpus.back().params.emplace_back(1);
+		corpus.back().params.emplace_back(2);
+
+		corpus.push_back({ "struct", "get_name", {} });
+		corpus.back().params.emplace_back(MakeUser(7));
+
+		corpus.push_back({ "nested64", "echo", {} });
+		corpus.back().params.emplace_back(MakeNested(64));
+
+		jsonrpc::Value::Array users;
+		for (int i = 0; i < 1000; ++i) {
+			users.emplace_back(MakeUser(i));
+		}
+		corpus.push_back({ "structs1000", "count", {} });
+		corpus.back().params.emplace_back(std::move(users));
+
+		jsonrpc::Value::Array numbers;
+		for (int i = 0; i < 400000; ++i) {
+			numbers.emplace_back(i % 3 == 0 ? jsonrpc::Value(i * 0.5) : jsonrpc::Value(i));
+		}
+		corpus.push_back({ "numbers400k", "sum", {} });
+		corpus.back().params.emplace_back(std::move(numbers));
+
+		return corpus;
+	}
+
+	void RegisterMethods(jsonrpc::Dispatcher& dispatcher) {
+		dispatcher.AddMethod("add", [](int a, int b) { return a + b; });
+		dispatcher.AddMethod("get_name", [](const jsonrpc::ValueView& user) { return user["name"].AsString(); });
+		dispatcher.AddMethod("echo", [](const jsonrpc::ValueView& value) { return value.ToValue(); });
+		dispatcher.AddMethod("count", [](const jsonrpc::ValueView& users) { return static_cast<int>(users.Size()); });
+		dispatcher.AddMethod("sum", [](const jsonrpc::ValueView& numbers) {
+			double sum = 0;
+			for (size_t i = 0; i < numbers.Size(); ++i) {
+				sum += numbers[i].ToDouble();
+			}
+			return sum;
+		});
+	}
+
+	// The same methods, for a StaticDispatcher
+	int Add(int a, int b) { return a + b; }
+	std::string GetName(const jsonrpc::ValueView& user) { return user["name"].AsString(); }
+	jsonrpc::Value Echo(const jsonrpc::ValueView& value) { return value.ToValue(); }
+	int Count(const jsonrpc::ValueView& users) { return static_cast<int>(users.Size()); }
+	double Sum(const jsonrpc::ValueView& numbers) {
+		double sum = 0;
+		for (size_t i = 0; i < numbers.Size(); ++i) {
+			sum += numbers[i].ToDouble();
+		}
+		return sum;
+	}
+
+	constexpr char ADD[] = "add";
+	constexpr char GET_NAME[] = "get_name";
+	constexpr char ECHO[] = "echo";
+	constexpr char COUNT[] = "count";
+	constexpr char SUM[] = "sum";
+
+	typedef jsonrpc::StaticDispatcher<
+		JSONRPC_LEAN_STATIC_METHOD(ADD, &Add),
+		JSONRPC_LEAN_STATIC_METHOD(GET_NAME, &GetName),
+		JSONRPC_LEAN_STATIC_METHOD(ECHO, &Echo),
+		JSONRPC_LEAN_STATIC_METHOD(COUNT, &Count),
+		JSONRPC_LEAN_STATIC_METHOD(SUM, &Sum)> StaticMethods;
+
+	std::string ToString(const std::shared_ptr<jsonrpc::FormattedData>& data) {
+		return std::string(data->GetData(), data->GetSize());
+	}
+
+	void RunCorpus() {
+		jsonrpc::JsonFormatHandler formatHandler;
+		jsonrpc::Server server;
+		server.RegisterFormatHandler(formatHandler);
+		RegisterMethods(server.GetDispatcher());
+		jsonrpc::Client client(formatHandler);
+		const StaticMethods staticMethods(server.GetDispatcher());
+
+		for (auto& payload : MakeCorpus()) {
+			const std::string request = ToString(client.BuildRequestData(payload.method, payload.params));
+			const std::string response = ToString(server.HandleRequest(request));
+			const std::string suffix = "/" + payload.name;
+
+			Run("JsonReader::GetRequestView" + suffix, request.size(), [&] {
+				jsonrpc::JsonReader reader(request.data(), request.size());
+				return reader.GetRequestView().GetParametersView().Size();
+			});
+
+			// checking ParseLimits while parsing, with limits none of the payloads reach
+			{
+				jsonrpc::ParseLimits limits;
+				limits.maximumDepth = 256;
+				limits.maximumStringLength = 64 << 20;
+				Run("JsonReader::GetRequestView+limits" + suffix, request.size(), [&] {
+					jsonrpc::JsonReader reader(request.data(), request.size(), nullptr, &limits);
+					return reader.GetRequestView().GetParametersView().Size();
+				});
+			}
+
+			Run("JsonReader::GetValue" + suffix, request.size(), [&] {
+				jsonrpc::JsonReader reader(request.data(), request.size());
+				return static_cast<size_t>(reader.GetValue().GetType());
+			});
+
+			{
+				jsonrpc::JsonReader reader(request.data(), request.size());
+				const jsonrpc::Request parsed = reader.GetRequest();
+				Run("Dispatcher::Invoke" + suffix, 0, [&] {
+					return static_cast<size_t>(server.GetDispatcher().Invoke(parsed).GetResult().GetType());
+				});
+				Run("StaticDispatcher::Invoke" + suffix, 0, [&] {
+					return static_cast<size_t>(staticMethods.Invoke(parsed).GetResult().GetType());
+				});
+			}
+
+			{
+				jsonrpc::Value params(payload.params.begin(), payload.params.end());
+				Run("Value::Write" + suffix, request.size(), [&] {
+					jsonrpc::JsonWriter writer;
+					params.Write(writer);
+					return writer.GetData()->GetSize();
+				});
+			}
+
+			Run("Server::HandleRequest" + suffix, request.size() + response.size(), [&] {
+				return server.HandleRequest(request)->GetSize();
+			});
+
+			// the same with metrics (Dispatcher::SetMetricsEnabled), to see what recording them costs
+			server.GetDispatcher().SetMetricsEnabled();
+			Run("Server::HandleRequest+metrics" + suffix, request.size() + response.size(), [&] {
+				return server.HandleRequest(request)->GetSize();
+			});
+			server.GetDispatcher().SetMetricsEnabled(false);
+
+			// and with the methods dispatched by a StaticDispatcher instead
+			server.SetStaticMethods(&staticMethods);
+			Run("Server::HandleRequest+static" + suffix, request.size() + response.size(), [&] {
+				return server.HandleRequest(request)->GetSize();
+			});
+			server.SetStaticMethods(nullptr);
+
+			// handing the response over in chunks as it is written, as to a socket
+			size_t sent = 0;
+			jsonrpc::CallbackOutputSink sink([&](const char*, size_t size) { sent += size; });
+			Run("Server::HandleRequest(sink)" + suffix, request.size() + response.size(), [&] {
+				server.HandleRequest(request, sink);
+				return sent;
+			});
+
+			Run("Client::BuildRequestData" + suffix, request.size(), [&] {
+				return client.BuildRequestData(payload.method, payload.params)->GetSize();
+			});
+
+			Run("Client::ParseResponse" + suffix, response.size(), [&] {
+				return static_cast<size_t>(client.ParseResponse(response).GetResult().GetType());
+			});
+		}
+	}
+
+	// Requests rejected before any method runs, as scanners and broken clients send them
+	void RunInvalid() {
+		jsonrpc::JsonFormatHandler formatHandler;
+		jsonrpc::Server server;
+		server.RegisterFormatHandler(formatHandler);
+		RegisterMethods(server.GetDispatcher());
+
+		const std::pair<const char*, std::string> requests[] = {
+			{ "parse_error", R"({"jsonrpc":"2.0","method":"add","params":[1,2)" },
+			{ "invalid_request", R"({"jsonrpc":"1.0","method":"add","params":[1,2],"id":1})" },
+			{ "unknown_method", R"({"jsonrpc":"2.0","method":"nope","params":[1,2],"id":1})" },
+			{ "invalid_params", R"({"jsonrpc":"2.0","method":"add","params":[1,"2"],"id":1})" },
+		};
+		for (auto& request : requests) {
+			Run(std::string("Server::HandleRequest/") + request.first, request.second.size(), [&] {
+				return server.HandleRequest(request.second)->GetSize();
+			});
+		}
+
+		// over ParseLimits, refused as soon as the parser gets there
+		jsonrpc::ParseLimits limits;
+		limits.maximumDepth = 32;
+		limits.maximumArraySize = 1000;
+		server.SetParseLimits(limits);
+		std::string elements = "[0";
+		for (size_t i = 1; i < 100000; ++i) {
+			elements += ",0";
+		}
+		const std::pair<const char*, std::string> oversized[] = {
+			{ "too_deep", R"({"jsonrpc":"2.0","method":"add","params":)" + std::string(10000, '[') + std::string(10000, ']') + R"(,"id":1})" },
+			{ "too_many_elements", R"({"jsonrpc":"2.0","method":"add","params":[)" + elements + R"(]],"id":1})" },
+		};
+		for (auto& request : oversized) {
+			Run(std::string("Server::HandleRequest/") + request.first, request.second.size(), [&] {
+				return server.HandleRequest(request.second)->GetSize();
+			});
+		}
+	}
+
+	void RunBase64() {
+		for (size_t size : { size_t(64), size_t(4096), size_t(4) << 20 }) {
+			std::string data(size, '\0');
+			uint32_t state = 1;
+			for (auto& c : data) {
+				state = state * 1664525 + 1013904223;
+				c = static_cast<char>(state >> 24);
+			}
+			const std::string encoded = jsonrpc::util::Base64Encode(data);
+			const std::string suffix = "/" + std::to_string(size);
+
+			Run("util::Base64Encode" + suffix, size, [&] {
+				return jsonrpc::util::Base64Encode(data).size();
+			});
+
+			Run("util::Base64Decode" + suffix, size, [&] {
+				return jsonrpc::util::Base64Decode(encoded).size();
+			});
+
+			// into buffers kept from one call to the next
+			std::string encodeBuffer(jsonrpc::util::Base64EncodedSize(size), '\0');
+			Run("util::Base64Encode(buffer)" + suffix, size, [&] {
+				return jsonrpc::util::Base64Encode(data.data(), data.size(), &encodeBuffer[0]);
+			});
+
+			std::string decodeBuffer(jsonrpc::util::Base64MaximumDecodedSize(encoded.size()), '\0');
+			Run("util::Base64Decode(buffer)" + suffix, size, [&] {
+				return jsonrpc::util::Base64Decode(encoded.data(), encoded.size(), &decodeBuffer[0]);
+			});
+		}
+	}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc > 1) {
+		filter = argv[1];
+	}
+	if (argc > 2) {
+		minimumSeconds = std::atof(argv[2]);
+	}
+
+	std::printf("%-40s %10s %20s %15s %20s\n", "benchmark", "iterations", "time", "throughput", "allocations");
+	RunCorpus();
+	RunInvalid();
+	RunBase64();
+	return 0;
+}
@@ -20,6 +20,7 @@
 #include "../include/jsonrpc-lean/client.h"
 #include "../include/jsonrpc-lean/fault.h"
 #include "../include/jsonrpc-lean/jsonformathandler.h"
+#include "../include/jsonrpc-lean/pipelinedclient.h"
 
 #include <cstring>
 #include <iostream>
@@ -165,6 +166,25 @@ int main(int argc, char** argv) {
             params.emplace_back(std::move(calls));
         }
 
+        // The server's fault for a request it could not parse has no id: it answers none of the pipelined calls
+        const char parseErrorResponse[] = "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32700,\"message\":\"Parse error\"}}";
+        const char pipelinedAddResponse[] = "{\"jsonrpc\":\"2.0\",\"id\":0,\"result\":5}";
+        jsonrpc::PipelinedClient pipelinedClient(*formatHandler);
+        params.clear();
+        params.emplace_back(3);
+        params.emplace_back(2);
+        auto pipelinedCall = pipelinedClient.BuildRequestData("add", params);
+        std::cout << "Pipelined add(3, 2) >>> " << pipelinedCall.data->GetData() << std::endl;
+        if (pipelinedClient.HandleResponse(parseErrorResponse)) {
+            ++CallErrors;
+            std::cout << "Error: parse error response matched a call" << std::endl;
+        }
+        if (!pipelinedClient.HandleResponse(pipelinedAddResponse)) {
+            ++CallErrors;
+            std::cout << "Error: response did not match the call" << std::endl;
+        }
+        std::cout << "Parsed pipelined response: " << pipelinedCall.result.get().AsInteger32() << std::endl << std::endl;
+
     } catch (const std::exception& ex) {
         std::cerr << "Error: " << ex.what() << "\n";
         return 1;
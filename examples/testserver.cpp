@@ -25,6 +25,7 @@
 
 #include <iostream>
 #include <numeric>
+#include <stdexcept>
 #include <string>
 #include <memory>
 #include <stdint.h>
@@ -84,6 +85,12 @@ void RunServer() {
 	dispatcher.AddMethod("to_struct", &ToStruct);
 	dispatcher.AddMethod("print_notification", &PrintNotification);
 
+	// an asynchronous method that throws after completing its call: it is answered once, with its result
+	dispatcher.AddAsyncMethod("complete_then_throw", [](const jsonrpc::ValueView&, jsonrpc::AsyncCompletion done) {
+		done.Complete(jsonrpc::Value("completed"));
+		throw jsonrpc::Fault("thrown after completing");
+	});
+
 	dispatcher.GetMethod("add")
 		.SetHelpText("Add two integers")
 		.AddSignature(jsonrpc::Value::Type::INTEGER_32, jsonrpc::Value::Type::INTEGER_32, jsonrpc::Value::Type::INTEGER_32);
@@ -127,6 +134,21 @@ void RunServer() {
     std::cout << "request: " << printNotificationRequest << std::endl;
     outputFormatedData = server.HandleRequest(printNotificationRequest);
     std::cout << "response size: " << outputFormatedData->GetSize() << std::endl;
+
+    const char completeThenThrowRequest[] = "{\"jsonrpc\":\"2.0\",\"method\":\"complete_then_throw\",\"id\":5}";
+    const char completeThenThrowBatch[] = "[{\"jsonrpc\":\"2.0\",\"method\":\"complete_then_throw\",\"id\":6},"
+        "{\"jsonrpc\":\"2.0\",\"method\":\"complete_then_throw\",\"id\":7}]";
+    for (const char* request : { completeThenThrowRequest, completeThenThrowBatch }) {
+        size_t responseCount = 0;
+        std::cout << "request: " << request << std::endl;
+        server.HandleRequestAsync(request, "application/json", [&](std::shared_ptr<jsonrpc::FormattedData> response) {
+            ++responseCount;
+            std::cout << "response: " << response->GetData() << std::endl;
+        });
+        if (responseCount != 1) {
+            throw std::logic_error(std::to_string(responseCount) + " responses to complete_then_throw");
+        }
+    }
 }
 
 int main() {
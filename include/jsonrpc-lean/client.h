@@ -18,6 +18,7 @@
 #ifndef JSONRPC_LEAN_CLIENT_H
 #define JSONRPC_LEAN_CLIENT_H
 
+#include "compat.h"
 #include "request.h"
 #include "value.h"
 #include "fault.h"
@@ -29,11 +30,15 @@
 #include "formatteddata.h"
 #include "jsonformatteddata.h"
 #include "dispatcher.h"
+#include "outputbuffer.h"
 
+#include <cstring>
 #include <functional>
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 namespace jsonrpc {
 
@@ -41,6 +46,19 @@ namespace jsonrpc {
 
     class Client {
     public:
+        // One element of BuildBatchRequestData
+        struct BatchCall {
+            BatchCall(std::string methodName, Request::Parameters params = {}, bool isNotification = false)
+                : methodName(std::move(methodName)), params(std::move(params)), isNotification(isNotification) {
+            }
+
+            std::string methodName;
+            Request::Parameters params;
+            bool isNotification;
+        };
+
+        typedef std::unordered_map<int32_t, Response> BatchResponses;
+
         Client(FormatHandler& formatHandler) : myFormatHandler(formatHandler), myId(0) {
 
         }
@@ -60,6 +78,44 @@ namespace jsonrpc {
             return BuildRequestDataInternal(methodName, params, std::forward<RestTypes>(rest)...);
         }
 
+        // Writes the request into aOutput, reusing the capacity it already has
+        void BuildRequestData(OutputBuffer& aOutput, const std::string& methodName, const Request::Parameters& params = {}) {
+            auto writer = myFormatHandler.CreateWriter(aOutput.Take());
+            const Value id(myId++);
+            WriteStatic(*writer, [&](auto& w) { Request::Write(methodName, params, id, w); });
+            aOutput.Put(writer->GetData()->ReleaseBuffer());
+        }
+
+        // Writes all the calls as one batch, with a single writer and buffer. ids (if given) receives the id of each
+        // call that isn't a notification, in order, to find its answer in ParseBatchResponse. calls must not be empty.
+        std::shared_ptr<FormattedData> BuildBatchRequestData(const std::vector<BatchCall>& calls, std::vector<int32_t>* ids = nullptr) {
+            if (ids != nullptr) {
+                ids->clear();
+                ids->reserve(calls.size());
+            }
+
+            auto writer = myFormatHandler.CreateWriter();
+            WriteStatic(*writer, [&](auto& w) {
+                w.StartDocument();
+                w.StartBatch();
+                for (auto& call : calls) {
+                    if (call.isNotification) {
+                        Request::WriteRequest(call.methodName, call.params, false, w);
+                        continue;
+                    }
+                    const Value id(myId);
+                    if (ids != nullptr) {
+                        ids->push_back(myId);
+                    }
+                    ++myId;
+                    Request::WriteRequest(call.methodName, call.params, id, w);
+                }
+                w.EndBatch();
+                w.EndDocument();
+            });
+            return writer->GetData();
+        }
+
         std::shared_ptr<FormattedData> BuildNotificationData(const std::string& methodName, const Request::Parameters& params = {}) {
             return BuildNotificationDataInternal(methodName, params);
         }
@@ -74,9 +130,41 @@ namespace jsonrpc {
         }
 
         Response ParseResponse(const std::string& aResponseData) {
-            return ParseResponseInternal(aResponseData);
+            return ParseResponseInternal(myFormatHandler.CreateReader(aResponseData));
+        }
+
+        // Reads straight from the caller's buffer, without copying it into a std::string first
+        Response ParseResponse(const char* aResponseData, size_t aSize) {
+            return ParseResponseInternal(myFormatHandler.CreateReader(aResponseData, aSize));
         }
 
+        // Parses the answer to BuildBatchRequestData once, into responses keyed by id. Faults are returned as
+        // responses (check Response::IsFault) since each call fails on its own; calls missing from the result got
+        // no answer, or one the server couldn't tie to a request (null id). An error answering the batch as a
+        // whole (e.g. a parse error) is thrown, and empty data (a batch of notifications only) gives no responses.
+        BatchResponses ParseBatchResponse(const std::string& aResponseData) {
+            return aResponseData.empty() ? BatchResponses() : ParseBatchResponseInternal(myFormatHandler.CreateReader(aResponseData));
+        }
+
+        BatchResponses ParseBatchResponse(const char* aResponseData, size_t aSize) {
+            return aSize == 0 ? BatchResponses() : ParseBatchResponseInternal(myFormatHandler.CreateReader(aResponseData, aSize));
+        }
+
+        // Pulls the response through aRead while parsing it, so large results are never held in memory as text
+        Response ParseResponseStream(const Reader::ReadFunction& aRead) {
+            return ParseResponseInternal(myFormatHandler.CreateStreamReader(aRead));
+        }
+
+#ifdef JSONRPC_LEAN_HAS_STRING_VIEW
+        Response ParseResponse(std::string_view aResponseData) {
+            return ParseResponse(aResponseData.data(), aResponseData.size());
+        }
+
+        Response ParseResponse(const char* aResponseData) {
+            return ParseResponse(aResponseData, strlen(aResponseData));
+        }
+#endif
+
         Client(const Client&) = delete;
         Client& operator=(const Client&) = delete;
         Client(Client&&) = delete;
@@ -91,8 +179,8 @@ namespace jsonrpc {
 
         std::shared_ptr<FormattedData> BuildRequestDataInternal(const std::string& methodName, const Request::Parameters& params) {
             auto writer = myFormatHandler.CreateWriter();
-            const auto id = myId++;
-            Request::Write(methodName, params, id, *writer);
+            const Value id(myId++);
+            WriteStatic(*writer, [&](auto& w) { Request::Write(methodName, params, id, w); });
             return writer->GetData();
         }
 
@@ -104,17 +192,43 @@ namespace jsonrpc {
 
         std::shared_ptr<FormattedData> BuildNotificationDataInternal(const std::string& methodName, const Request::Parameters& params) {
             auto writer = myFormatHandler.CreateWriter();
-            Request::Write(methodName, params, false, *writer);
+            WriteStatic(*writer, [&](auto& w) { Request::Write(methodName, params, false, w); });
             return writer->GetData();
         }
 
-        Response ParseResponseInternal(const std::string& aResponseData) {
-            auto reader = myFormatHandler.CreateReader(aResponseData);
+        Response ParseResponseInternal(std::unique_ptr<Reader> reader) {
             Response response = reader->GetResponse();
             response.ThrowIfFault();
             return std::move(response);
         }
 
+        BatchResponses ParseBatchResponseInternal(std::unique_ptr<Reader> reader) {
+            BatchResponses responses;
+            if (!reader->IsBatch()) {
+                Response response = reader->GetResponse();
+                response.ThrowIfFault();
+                if (response.GetId().IsInt32()) {
+                    responses.emplace(response.GetId().AsInt32(), std::move(response));
+                }
+                return responses;
+            }
+
+            const size_t size = reader->GetBatchSize();
+            responses.reserve(size);
+            for (size_t i = 0; i < size; ++i) {
+                try {
+                    Response response = reader->GetBatchResponse(i);
+                    if (response.GetId().IsInt32()) {
+                        const int32_t id = response.GetId().AsInt32();
+                        responses.emplace(id, std::move(response));
+                    }
+                } catch (const InvalidRequestFault&) {
+                    // errors for elements the server couldn't read come without an id, nothing to tie them to
+                }
+            }
+            return responses;
+        }
+
         FormatHandler& myFormatHandler;
         int32_t myId;
     };
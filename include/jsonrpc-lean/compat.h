@@ -0,0 +1,61 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_COMPAT_H
+#define JSONRPC_LEAN_COMPAT_H
+
+// MSVC keeps __cplusplus at 199711L unless /Zc:__cplusplus is given
+#if defined(_MSVC_LANG)
+#define JSONRPC_LEAN_CPLUSPLUS _MSVC_LANG
+#else
+#define JSONRPC_LEAN_CPLUSPLUS __cplusplus
+#endif
+
+#if JSONRPC_LEAN_CPLUSPLUS >= 201703L
+#define JSONRPC_LEAN_HAS_STRING_VIEW 1
+#include <string_view>
+#endif
+
+// std::to_chars/from_chars for doubles (C++17, and only in newer standard libraries)
+#if JSONRPC_LEAN_CPLUSPLUS >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#if defined(__cpp_lib_to_chars)
+#define JSONRPC_LEAN_HAS_TO_CHARS 1
+#endif
+#endif
+#endif
+
+// C++20 coroutines: Task, methods returning one (Dispatcher::AddMethod) and PipelinedClient::Call
+#if JSONRPC_LEAN_CPLUSPLUS >= 202002L && defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define JSONRPC_LEAN_HAS_COROUTINES 1
+#endif
+#endif
+
+// SIMD kernels (base64): SSSE3 and AVX2 on x86, picked at runtime from what the CPU supports, and NEON on
+// AArch64 where it is always there. Define JSONRPC_LEAN_NO_SIMD to only build the portable code.
+#if !defined(JSONRPC_LEAN_NO_SIMD)
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && (defined(__GNUC__) || defined(_MSC_VER))
+#define JSONRPC_LEAN_HAS_X86_SIMD 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define JSONRPC_LEAN_HAS_NEON 1
+#endif
+#endif
+
+#endif // JSONRPC_LEAN_COMPAT_H
@@ -21,9 +21,15 @@
 #define JSONRPC_LEAN_DISPATCHER_H
 
 #include "fault.h"
+#include "metrics.h"
+#include "parameternames.h"
 #include "request.h"
 #include "response.h"
+#include "responsecache.h"
+#include "snapshot.h"
 #include "value.h"
+#include "task.h"
+#include "valueview.h"
 
 //#if __cplusplus <= 201103L
 #include "integer_seq.h"
@@ -33,17 +39,79 @@
 //} // namespace std
 //#endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace jsonrpc {
 
+    // Given to asynchronous methods to deliver their result. One of Complete or Fail must be called, from any
+    // thread and at any time (also before the method returns). Only the first call counts: the copies share
+    // whether the call is done, and later calls, or the fault of a method throwing after it completed, are ignored.
+    class AsyncCompletion {
+    public:
+        typedef std::function<void(Response response)> Callback;
+
+        AsyncCompletion(Value id, Callback callback) : myState(std::make_shared<State>(std::move(id), std::move(callback))) {}
+
+        void Complete(Value result) const {
+            Finish(Response(std::move(result), Value(myState->id)));
+        }
+
+        void Fail(const Fault& fault) const {
+            Finish(Response(fault.GetCode(), fault.GetString(), Value(myState->id)));
+        }
+
+    private:
+        friend class Dispatcher;
+
+        // Value can't be copied implicitly, and completions are copied around with the callbacks holding them
+        struct State {
+            State(Value id, Callback callback) : id(std::move(id)), callback(std::move(callback)) {}
+
+            const Value id;
+            const Callback callback;
+            std::atomic<bool> done{ false };
+        };
+
+        // False if the call was already done, response is then dropped
+        bool Finish(Response response) const {
+            if (myState->done.exchange(true, std::memory_order_acq_rel)) {
+                return false;
+            }
+            myState->callback(std::move(response));
+            return true;
+        }
+
+        std::shared_ptr<State> myState;
+    };
+
     class MethodWrapper {
     public:
         typedef std::function<Value(const Request::Parameters&)> Method;
+        // Gets the parameters as a view, so only what the method reads is ever converted to a Value
+        typedef std::function<Value(const ValueView&)> ViewMethod;
+        // Like ViewMethod, but faults may be set in fault (the result is ignored then) instead of thrown, which
+        // costs far less when many calls fail; typed methods are bound this way. Throwing works all the same.
+        typedef std::function<Value(const ValueView&, FaultStatus& fault)> CheckedMethod;
+        // Starts the call and returns; the result is delivered later through the completion. The parameters
+        // are only valid until the method returns, anything needed afterwards must be copied.
+        typedef std::function<void(const ValueView&, AsyncCompletion)> AsyncMethod;
 
         explicit MethodWrapper(Method method) : myMethod(method) {}
+        explicit MethodWrapper(ViewMethod method) : myViewMethod(method) {}
+        explicit MethodWrapper(CheckedMethod method) : myCheckedMethod(method) {}
+        explicit MethodWrapper(AsyncMethod method) : myAsyncMethod(method) {}
+
+        ~MethodWrapper() { delete myMetrics.load(std::memory_order_relaxed); }
 
         MethodWrapper(const MethodWrapper&) = delete;
         MethodWrapper& operator=(const MethodWrapper&) = delete;
@@ -67,15 +135,215 @@ namespace jsonrpc {
         const std::vector<std::vector<Value::Type>>&
             GetSignatures() const { return mySignatures; }
 
+        // Lets the method be called with parameters by name (a JSON object) as well: each member is put in the
+        // place of the parameter it names, those not given are left undefined, and a name the method doesn't
+        // have is invalid. Without names, an object is only given as it is to methods taking the raw view.
+        MethodWrapper& SetParameterNames(std::vector<std::string> names) {
+            myParameterNames.reset(new ParameterNames(std::move(names)));
+            return *this;
+        }
+
+        const ParameterNames* GetParameterNames() const { return myParameterNames.get(); }
+
+        bool IsAsync() const { return static_cast<bool>(myAsyncMethod); }
+
+        // For methods whose result only depends on their parameters: Server::HandleRequest then keeps the written
+        // result of up to maximumEntries calls for timeToLive, and answers the same parameters again by copying
+        // it out with the caller's id, without calling the method. Faults are not kept. Not for async methods.
+        MethodWrapper& SetCacheable(std::chrono::milliseconds timeToLive, size_t maximumEntries = 1024) {
+            myCache.reset(new ResponseCache(timeToLive, maximumEntries));
+            return *this;
+        }
+
+        // NULL unless the method is cacheable
+        ResponseCache* GetCache() const { return myCache.get(); }
+
+        // NULL until the method has been called with metrics enabled (see Dispatcher::SetMetricsEnabled)
+        const MethodMetrics* GetMetrics() const { return myMetrics.load(std::memory_order_acquire); }
+
+        // An asynchronous method is waited for, so it must not need this thread to complete
         Value operator()(const Request::Parameters& params) const {
-            return myMethod(params);
+            FaultStatus fault;
+            Value result = Call(params, fault);
+            ThrowIfFault(fault);
+            return result;
+        }
+
+        Value operator()(const Request& request) const {
+            FaultStatus fault;
+            Value result = Call(request, fault);
+            ThrowIfFault(fault);
+            return result;
+        }
+
+        // By-value parameters are moved out of the request's own parameters instead of copied (see
+        // Request::TakeParametersView); methods taking Request::Parameters still get a copy
+        Value operator()(Request&& request) const {
+            FaultStatus fault;
+            Value result = Call(std::move(request), fault);
+            ThrowIfFault(fault);
+            return result;
+        }
+
+        // Starts an asynchronous method
+        void operator()(const Request& request, AsyncCompletion completion) const {
+            FaultStatus fault;
+            InOrder(request.GetParametersView(), fault, [&](const ValueView& params) {
+                myAsyncMethod(params, std::move(completion));
+                return Value();
+            });
+            ThrowIfFault(fault);
         }
 
     private:
+        // The calls of the operators above, with invalid parameters set in fault instead of thrown; what the
+        // method itself throws still goes through
+        Value Call(const Request::Parameters& params, FaultStatus& fault) const {
+            if (myAsyncMethod) {
+                return Wait(ValueView(params));
+            }
+            return myMethod ? myMethod(params) : CallView(ValueView(params), fault);
+        }
+
+        Value Call(const Request& request, FaultStatus& fault) const {
+            if (request.GetParametersView().IsObject()) {
+                return InOrder(request.GetParametersView(), fault, [&](const ValueView& params) { return CallAny(params, fault); });
+            }
+            if (myAsyncMethod) {
+                return Wait(request.GetParametersView());
+            }
+            return myMethod ? myMethod(request.GetParameters()) : CallView(request.GetParametersView(), fault);
+        }
+
+        Value Call(Request&& request, FaultStatus& fault) const {
+            if (request.GetParametersView().IsObject()) {
+                return InOrder(request.GetParametersView(), fault, [&](const ValueView& params) { return CallAny(params, fault); });
+            }
+            if (myAsyncMethod) {
+                return Wait(request.TakeParametersView());
+            }
+            return myMethod ? myMethod(request.GetParameters()) : CallView(request.TakeParametersView(), fault);
+        }
+
+        static void ThrowIfFault(const FaultStatus& fault) {
+            if (fault) {
+                Response(fault.GetCode(), fault.GetString(), Value()).ThrowIfFault();
+            }
+        }
+
+        // Parameters by name are put in order, in one pass over the members; anything else is given as it is
+        template<typename CallType>
+        Value InOrder(const ValueView& params, FaultStatus& fault, CallType call) const {
+            if (!params.IsObject() || !myParameterNames) {
+                return call(params);
+            }
+
+            // most methods have a handful of parameters, those don't need the heap
+            const size_t size = myParameterNames->Size();
+            ValueView inlineSlots[8];
+            std::vector<ValueView> heapSlots;
+            ValueView* slots = inlineSlots;
+            if (size > 8) {
+                heapSlots.resize(size);
+                slots = heapSlots.data();
+            }
+
+            bool unknownName = false;
+            params.ForEachMember([&](const char* name, size_t nameSize, const ValueView& value) {
+                const size_t index = myParameterNames->Find(name, nameSize);
+                if (index == ParameterNames::NOT_FOUND) {
+                    unknownName = true;
+                } else {
+                    slots[index] = value;
+                }
+            });
+            if (unknownName) {
+                fault = InvalidParametersFault();
+                return Value();
+            }
+
+            const ValueView::List list = { slots, size };
+            return call(ValueView(list));
+        }
+
+        Value CallView(const ValueView& params, FaultStatus& fault) const {
+            return myCheckedMethod ? myCheckedMethod(params, fault) : myViewMethod(params);
+        }
+
+        // Whichever kind the method is
+        Value CallAny(const ValueView& params, FaultStatus& fault) const {
+            if (myAsyncMethod) {
+                return Wait(params);
+            }
+            if (!myMethod) {
+                return CallView(params, fault);
+            }
+            if (!params.IsArray() && !params.IsUndefined()) {
+                fault = InvalidParametersFault();
+                return Value();
+            }
+            Request::Parameters parameters;
+            for (size_t i = 0; i < params.Size(); ++i) {
+                parameters.emplace_back(params[i].ToValue());
+            }
+            return myMethod(parameters);
+        }
+
+        // Created on the first call, so methods that are never called (or metrics left off) cost nothing
+        MethodMetrics& UseMetrics() const {
+            MethodMetrics* metrics = myMetrics.load(std::memory_order_acquire);
+            if (metrics == nullptr) {
+                std::unique_ptr<MethodMetrics> created(new MethodMetrics());
+                if (myMetrics.compare_exchange_strong(metrics, created.get(), std::memory_order_acq_rel)) {
+                    metrics = created.release();
+                }
+            }
+            return *metrics;
+        }
+
+        Value Wait(const ValueView& params) const {
+            // shared with the completion, which may outlive this call if the method throws after handing it on
+            auto promise = std::make_shared<std::promise<Response>>();
+            auto future = promise->get_future();
+            myAsyncMethod(params, AsyncCompletion(Value(), [promise](Response response) { promise->set_value(std::move(response)); }));
+
+            Response response = future.get();
+            response.ThrowIfFault();
+            return std::move(response.GetResult());
+        }
+
         Method myMethod;
+        ViewMethod myViewMethod;
+        CheckedMethod myCheckedMethod;
+        AsyncMethod myAsyncMethod;
         bool myIsHidden = false;
         std::string myHelpText;
         std::vector<std::vector<Value::Type>> mySignatures;
+        std::unique_ptr<ParameterNames> myParameterNames;
+        mutable std::atomic<MethodMetrics*> myMetrics{ nullptr };
+        std::unique_ptr<ResponseCache> myCache;
+
+        friend class Dispatcher;
+    };
+
+    // Method resolved once by Dispatcher::GetMethodHandle, so hot callers can invoke it without a name lookup.
+    // Only valid until the method is removed from the dispatcher (in concurrent mode, until it is destroyed).
+    class MethodHandle {
+    public:
+        MethodHandle() {}
+
+        explicit operator bool() const { return myMethod != nullptr; }
+
+        const std::string& GetName() const { return *myName; }
+        const MethodWrapper& GetMethod() const { return *myMethod; }
+
+    private:
+        MethodHandle(const std::string& name, const MethodWrapper& method) : myName(&name), myMethod(&method) {}
+
+        const std::string* myName = nullptr;
+        const MethodWrapper* myMethod = nullptr;
+
+        friend class Dispatcher;
     };
 
     template<typename> struct ToStdFunction;
@@ -109,34 +377,192 @@ namespace jsonrpc {
             decltype(&MethodType::operator()) > ::Type Type;
     };
 
+    // Converts one element of the parameters view to the type the method was declared with.
+    // Scalars and strings are decoded straight from the view, only containers go through a Value.
+    // Matches tells whether Get will succeed, so a typed method can check all of its parameters
+    // before converting any, and reject them without throwing.
+    template<typename T>
+    struct ViewParameter {
+        // other types find out by converting
+        static bool Matches(const ValueView& view) {
+            return std::is_same<T, Value::Array>::value ? view.IsArray() :
+                std::is_same<T, Value::Object>::value ? view.IsObject() : true;
+        }
+
+        static T Get(const ValueView& view) {
+            Value value = view.ToValue();
+            try {
+                return std::move(value.AsType<T>());
+            }
+            catch (const std::invalid_argument&) {
+                throw InvalidParametersFault();
+            }
+        }
+    };
+
+    template<>
+    struct ViewParameter<Value::Boolean> {
+        static bool Matches(const ValueView& view) { return view.IsBoolean(); }
+
+        static Value::Boolean Get(const ValueView& view) {
+            if (!view.IsBoolean()) {
+                throw InvalidParametersFault();
+            }
+            return view.AsBoolean();
+        }
+    };
+
+    template<>
+    struct ViewParameter<Value::Int32> {
+        static bool Matches(const ValueView& view) { return view.IsInt32(); }
+
+        static Value::Int32 Get(const ValueView& view) {
+            if (!view.IsInt32()) {
+                throw InvalidParametersFault();
+            }
+            return view.AsInt32();
+        }
+    };
+
+    // Integers are accepted too, JSON makes no difference between 2 and 2.0
+    template<>
+    struct ViewParameter<Value::Double> {
+        static bool Matches(const ValueView& view) { return view.IsNumber(); }
+
+        static Value::Double Get(const ValueView& view) {
+            if (!view.IsNumber()) {
+                throw InvalidParametersFault();
+            }
+            return view.ToDouble();
+        }
+    };
+
+    template<>
+    struct ViewParameter<Value::String> {
+        static bool Matches(const ValueView& view) { return view.IsString(); }
+
+        static Value::String Get(const ValueView& view) {
+            if (!view.IsString()) {
+                throw InvalidParametersFault();
+            }
+            // a string the request held itself is taken over instead of copied
+            return view.IsMovable() ? std::move(view.ToValue().AsString()) : view.AsString();
+        }
+    };
+
+    template<>
+    struct ViewParameter<ValueView> {
+        static bool Matches(const ValueView&) { return true; }
+
+        static ValueView Get(const ValueView& view) {
+            return view;
+        }
+    };
+
     class Dispatcher {
     public:
+        // In concurrent mode methods can be added and removed while other threads dispatch: each change publishes
+        // a new copy of the method table, and dispatching reads whichever table is current without any lock.
+        // Tables replaced and methods removed are only freed with the dispatcher, so a change costs a copy of the
+        // table and some memory; fine for plugins loading now and then, not for methods added per request.
+        // MethodWrappers returned by AddMethod are shared by all tables, set their help text and signatures right
+        // away if other threads may list them. Must be chosen before the dispatcher is used by several threads.
+        void SetConcurrent(bool concurrent = true) { myConcurrent = concurrent; }
+
+        // Counts the calls and faults of each method and records how long they take, and the Server records
+        // parse and serialise times and message sizes too. Recording takes a couple of clock reads and relaxed
+        // atomic increments per call, without locks. Like concurrent mode, set before requests are handled.
+        void SetMetricsEnabled(bool enabled = true) {
+            if (!enabled) {
+                myMetrics.reset();
+            } else if (!myMetrics) {
+                myMetrics.reset(new Metrics());
+            }
+        }
+
+        // NULL if metrics are not enabled
+        Metrics* GetMetrics() const { return myMetrics.get(); }
+
+        // Only methods called since metrics were enabled are listed, sorted by name
+        MetricsReport GetMetricsReport() const {
+            MetricsReport report;
+            if (myMetrics) {
+                myMetrics->GetReport(report);
+            }
+            for (auto& slot : myTable.Get().slots) {
+                if (!slot.entry) {
+                    continue;
+                }
+                if (const MethodMetrics* metrics = slot.entry->method.GetMetrics()) {
+                    report.methods.emplace_back(metrics->GetReport(slot.entry->name));
+                }
+            }
+            std::sort(report.methods.begin(), report.methods.end(),
+                [](const MethodReport& a, const MethodReport& b) { return a.name < b.name; });
+            return report;
+        }
+
+        // Adds a hidden method answering GetMetricsReport as a Value (names starting with "rpc." are reserved
+        // by JSON-RPC for such extensions). Enables metrics if they aren't.
+        MethodWrapper& AddMetricsMethod(std::string name = "rpc.metrics") {
+            SetMetricsEnabled();
+            MethodWrapper& method = AddMethod(std::move(name), MethodWrapper::ViewMethod([this](const ValueView&) {
+                return GetMetricsReport().ToValue();
+            }));
+            method.SetHidden();
+            return method;
+        }
+
         std::vector<std::string> GetMethodNames(bool includeHidden = false) const {
+            const Table& table = myTable.Get();
             std::vector<std::string> names;
-            names.reserve(myMethods.size());
+            names.reserve(table.count);
 
-            for (auto& method : myMethods) {
-                if (includeHidden || !method.second.IsHidden()) {
-                    names.emplace_back(method.first);
+            for (auto& slot : table.slots) {
+                if (slot.entry && (includeHidden || !slot.entry->method.IsHidden())) {
+                    names.emplace_back(slot.entry->name);
                 }
             }
 
+            // the table has no meaningful order, keep the names sorted as they always were
+            std::sort(names.begin(), names.end());
             return names;
         }
 
         MethodWrapper& GetMethod(const std::string& name) {
-            return myMethods.at(name);
+            const Table& table = myTable.Get();
+            size_t index = table.Find(name, std::hash<std::string>()(name));
+            if (index == NOT_FOUND) {
+                throw std::out_of_range(name + ": no such method");
+            }
+            return table.slots[index].entry->method;
         }
 
-        MethodWrapper& AddMethod(std::string name, MethodWrapper::Method method) {
-            auto result = myMethods.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(std::move(name)),
-                std::forward_as_tuple(std::move(method)));
-            if (!result.second) {
-                throw std::invalid_argument(name + ": method already added");
+        // Empty handle if there is no such method
+        MethodHandle GetMethodHandle(const std::string& name) const {
+            const Table& table = myTable.Get();
+            size_t index = table.Find(name, std::hash<std::string>()(name));
+            if (index == NOT_FOUND) {
+                return MethodHandle();
             }
-            return result.first->second;
+            auto& entry = *table.slots[index].entry;
+            return MethodHandle(entry.name, entry.method);
+        }
+
+        MethodWrapper& AddMethod(std::string name, MethodWrapper::Method method) {
+            return Insert(std::move(name), std::move(method));
+        }
+
+        MethodWrapper& AddMethod(std::string name, MethodWrapper::ViewMethod method) {
+            return Insert(std::move(name), std::move(method));
+        }
+
+        MethodWrapper& AddMethod(std::string name, MethodWrapper::CheckedMethod method) {
+            return Insert(std::move(name), std::move(method));
+        }
+
+        MethodWrapper& AddAsyncMethod(std::string name, MethodWrapper::AsyncMethod method) {
+            return Insert(std::move(name), std::move(method));
         }
 
         template<typename MethodType>
@@ -175,34 +601,136 @@ namespace jsonrpc {
             return AddMethodInternal(std::move(name), std::move(function));
         }
 
+        // Invalidates handles to the removed method only
         void RemoveMethod(const std::string& name) {
-            myMethods.erase(name);
+            const size_t hash = std::hash<std::string>()(name);
+            if (myTable.Get().Find(name, hash) == NOT_FOUND) {
+                return;
+            }
+            Change([&](Table& table) {
+                size_t index = table.Find(name, hash);
+                if (index != NOT_FOUND) {
+                    table.Remove(index);
+                }
+            });
         }
 
         Response Invoke(const std::string& name, const Request::Parameters& parameters, const Value& id) const {
+            return InvokeInternal(GetMethodHandle(name), name, Value(id),
+                [&](const MethodWrapper& method, FaultStatus& fault) { return method.Call(parameters, fault); });
+        }
+
+        // Lets methods taking ValueView parameters read straight from the request's parameters view
+        Response Invoke(const Request& request) const {
+            return InvokeInternal(GetMethodHandle(request.GetMethodName()), request.GetMethodName(), Value(request.GetId()),
+                [&](const MethodWrapper& method, FaultStatus& fault) { return method.Call(request, fault); });
+        }
+
+        // Same, but the request is given up: by-value (or rvalue reference) parameters of the method are moved
+        // from the parameters the request holds instead of copied, and its id is moved into the response
+        Response Invoke(Request&& request) const {
+            return Invoke(GetMethodHandle(request.GetMethodName()), std::move(request));
+        }
+
+        // With the method of the request looked up already
+        Response Invoke(const MethodHandle& method, Request&& request) const {
+            return InvokeInternal(method, request.GetMethodName(), request.TakeId(),
+                [&](const MethodWrapper& wrapper, FaultStatus& fault) { return wrapper.Call(std::move(request), fault); });
+        }
+
+        Response Invoke(const MethodHandle& method, const Request::Parameters& parameters, const Value& id) const {
+            return InvokeInternal(method, method ? method.GetName() : std::string(), Value(id),
+                [&](const MethodWrapper& wrapper, FaultStatus& fault) { return wrapper.Call(parameters, fault); });
+        }
+
+        // onComplete is called exactly once with the response: before InvokeAsync returns for synchronous
+        // methods, or whenever (and on whichever thread) an asynchronous one completes. The request only has
+        // to stay valid until InvokeAsync returns.
+        void InvokeAsync(const Request& request, AsyncCompletion::Callback onComplete) const {
+            auto method = GetMethodHandle(request.GetMethodName());
+            if (!method || !method.GetMethod().IsAsync()) {
+                onComplete(Invoke(request));
+                return;
+            }
+
+            // timed until the call completes rather than until it is started
+            if (myMetrics) {
+                MethodMetrics& metrics = method.GetMethod().UseMetrics();
+                const Metrics::Clock::time_point start = Metrics::Clock::now();
+                onComplete = [&metrics, start, callback = std::move(onComplete)](Response response) {
+                    Record(metrics, start, response);
+                    callback(std::move(response));
+                };
+            }
+
+            // a method throwing instead of starting the call is answered with the fault right away, unless it
+            // had completed the call already
+            bool started = false;
+            AsyncCompletion completion(Value(request.GetId()), std::move(onComplete));
+            Response fault = Dispatch(method, request.GetMethodName(), Value(request.GetId()), [&](const MethodWrapper& wrapper, FaultStatus&) {
+                wrapper(request, completion);
+                started = true;
+                return Value();
+            });
+            if (!started) {
+                completion.Finish(std::move(fault));
+            }
+        }
+
+    private:
+        template<typename CallType>
+        Response InvokeInternal(const MethodHandle& method, const std::string& name, Value id, CallType call) const {
+            if (!myMetrics) {
+                return Dispatch(method, name, std::move(id), call);
+            }
+            if (!method) {
+                myMetrics->RecordUnknownMethod();
+                return Dispatch(method, name, std::move(id), call);
+            }
+
+            MethodMetrics& metrics = method.GetMethod().UseMetrics();
+            const Metrics::Clock::time_point start = Metrics::Clock::now();
+            Response response = Dispatch(method, name, std::move(id), call);
+            Record(metrics, start, response);
+            return response;
+        }
+
+        static void Record(MethodMetrics& metrics, Metrics::Clock::time_point start, const Response& response) {
+            metrics.RecordCall(Metrics::GetNanosecondsSince(start));
+            if (response.IsFault()) {
+                metrics.RecordFault(response.GetFaultCode());
+            }
+        }
+
+        // Unknown methods and the faults set by the call are answered without throwing
+        template<typename CallType>
+        Response Dispatch(const MethodHandle& method, const std::string& name, Value id, CallType call) const {
+            if (!method) {
+                return Response(Fault::METHOD_NOT_FOUND, "Method not found: " + name, std::move(id));
+            }
             try {
-                auto method = myMethods.find(name);
-                if (method == myMethods.end()) {
-                    throw MethodNotFoundFault("Method not found: " + name);
+                FaultStatus fault;
+                Value result = call(method.GetMethod(), fault);
+                if (fault) {
+                    return Response(fault.GetCode(), fault.GetString(), std::move(id));
                 }
-                return{ method->second(parameters), Value(id) };
+                return{ std::move(result), std::move(id) };
             }
             catch (const Fault& fault) {
-                return Response(fault.GetCode(), fault.GetString(), Value(id));
+                return Response(fault.GetCode(), fault.GetString(), std::move(id));
             }
             catch (const std::out_of_range&) {
                 InvalidParametersFault fault;
-                return Response(fault.GetCode(), fault.GetString(), Value(id));
+                return Response(fault.GetCode(), fault.GetString(), std::move(id));
             }
             catch (const std::exception& ex) {
-                return Response(0, ex.what(), Value(id));
+                return Response(0, ex.what(), std::move(id));
             }
             catch (...) {
-                return Response(0, "unknown error", Value(id));
+                return Response(0, "unknown error", std::move(id));
             }
         }
 
-    private:
         template<typename ReturnType, typename... ParameterTypes>
         MethodWrapper& AddMethodInternal(std::string name, std::function<ReturnType(ParameterTypes...)> method) {
             return AddMethodInternal(std::move(name), std::move(method), redi::index_sequence_for < ParameterTypes... > {});
@@ -217,18 +745,193 @@ namespace jsonrpc {
             return AddMethodInternal(std::move(name), std::move(returnMethod), redi::index_sequence_for < ParameterTypes... > {});
         }
 
+        // The signature drives the decoding: each argument is read from the parameters view as the type it
+        // is declared with, so the request's parameters are never turned into Values (unless a method wants them).
+        // They are all checked first, wrong ones are answered without throwing.
         template<typename ReturnType, typename... ParameterTypes, std::size_t... index>
         MethodWrapper& AddMethodInternal(std::string name, std::function<ReturnType(ParameterTypes...)> method, redi::index_sequence<index...>) {
-            MethodWrapper::Method realMethod = [method](const Request::Parameters& params) -> Value {
-                if (params.size() != sizeof...(ParameterTypes)) {
-                    throw InvalidParametersFault();
+            MethodWrapper::CheckedMethod realMethod = [method](const ValueView& params, FaultStatus& fault) -> Value {
+                if ((!params.IsArray() && !params.IsUndefined()) || params.Size() != sizeof...(ParameterTypes)
+                    || !AllOf({ true, ViewParameter<typename std::decay<ParameterTypes>::type>::Matches(params[index])... })) {
+                    fault = InvalidParametersFault();
+                    return Value();
                 }
-                return method(params[index].AsType<typename std::decay<ParameterTypes>::type>()...);
+                return method(ViewParameter<typename std::decay<ParameterTypes>::type>::Get(params[index])...);
             };
             return AddMethod(std::move(name), std::move(realMethod));
         }
 
-        std::map<std::string, MethodWrapper> myMethods;
+#ifdef JSONRPC_LEAN_HAS_COROUTINES
+        template<typename ReturnType, typename... ParameterTypes>
+        MethodWrapper& AddMethodInternal(std::string name, std::function<Task<ReturnType>(ParameterTypes...)> method) {
+            return AddMethodInternal(std::move(name), std::move(method), redi::index_sequence_for < ParameterTypes... > {});
+        }
+
+        // Coroutines are asynchronous methods: their parameters are checked and converted like those of the
+        // other typed methods, and the response is sent once the task is done
+        template<typename ReturnType, typename... ParameterTypes, std::size_t... index>
+        MethodWrapper& AddMethodInternal(std::string name, std::function<Task<ReturnType>(ParameterTypes...)> method, redi::index_sequence<index...>) {
+            static_assert((!std::is_same<typename std::decay<ParameterTypes>::type, ValueView>::value && ...),
+                "the request is gone once a coroutine suspends, it can't take a ValueView");
+            MethodWrapper::AsyncMethod realMethod = [method](const ValueView& params, AsyncCompletion completion) {
+                if ((!params.IsArray() && !params.IsUndefined()) || params.Size() != sizeof...(ParameterTypes)
+                    || !AllOf({ true, ViewParameter<typename std::decay<ParameterTypes>::type>::Matches(params[index])... })) {
+                    completion.Fail(InvalidParametersFault());
+                    return;
+                }
+                RunTask(method, std::move(completion), ViewParameter<typename std::decay<ParameterTypes>::type>::Get(params[index])...);
+            };
+            return AddAsyncMethod(std::move(name), std::move(realMethod));
+        }
+
+        // The arguments are kept in this coroutine's frame, so the method may take them by reference. method is
+        // the one held by its MethodWrapper, which lives as long as the dispatcher.
+        template<typename ReturnType, typename... ParameterTypes>
+        static detail::DetachedTask RunTask(const std::function<Task<ReturnType>(ParameterTypes...)>& method, AsyncCompletion completion,
+            typename std::decay<ParameterTypes>::type... arguments) {
+            Value result;
+            try {
+                if constexpr (std::is_void<ReturnType>::value) {
+                    co_await method(std::move(arguments)...);
+                } else {
+                    result = Value(co_await method(std::move(arguments)...));
+                }
+            }
+            catch (const Fault& fault) {
+                completion.Fail(fault);
+                co_return;
+            }
+            catch (const std::out_of_range&) {
+                completion.Fail(InvalidParametersFault());
+                co_return;
+            }
+            catch (const std::exception& ex) {
+                completion.Fail(Fault(ex.what()));
+                co_return;
+            }
+            catch (...) {
+                completion.Fail(Fault("unknown error"));
+                co_return;
+            }
+            completion.Complete(std::move(result));
+        }
+#endif
+
+        static bool AllOf(std::initializer_list<bool> values) {
+            return std::all_of(values.begin(), values.end(), [](bool value) { return value; });
+        }
+
+        struct MethodEntry {
+            template<typename MethodType>
+            MethodEntry(std::string name, MethodType method) : name(std::move(name)), method(std::move(method)) {}
+
+            std::string name;
+            MethodWrapper method;
+        };
+
+        // Open addressing with linear probing. Entries are allocated separately so that MethodWrapper
+        // references and handles survive rehashing (and are shared by the copies of concurrent mode); the
+        // hash is kept in the slot so probing only touches the table until a candidate with the same hash is found.
+        struct Slot {
+            size_t hash = 0;
+            std::shared_ptr<MethodEntry> entry;
+        };
+
+        static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+        struct Table {
+            size_t Find(const std::string& name, size_t hash) const {
+                if (slots.empty()) {
+                    return NOT_FOUND;
+                }
+                const size_t mask = slots.size() - 1;
+                for (size_t index = hash & mask; slots[index].entry; index = (index + 1) & mask) {
+                    if (slots[index].hash == hash && slots[index].entry->name == name) {
+                        return index;
+                    }
+                }
+                return NOT_FOUND;
+            }
+
+            void Add(Slot slot) {
+                // keep the load factor at or below one half
+                if ((count + 1) * 2 > slots.size()) {
+                    Rehash(slots.empty() ? 16 : slots.size() * 2);
+                }
+                Place(std::move(slot));
+                ++count;
+            }
+
+            void Remove(size_t index) {
+                // backward shift deletion: pull following entries of the probe sequence into the hole
+                const size_t mask = slots.size() - 1;
+                slots[index] = Slot();
+                --count;
+                for (size_t next = (index + 1) & mask; slots[next].entry; next = (next + 1) & mask) {
+                    size_t home = slots[next].hash & mask;
+                    if (((next - home) & mask) >= ((next - index) & mask)) {
+                        slots[index] = std::move(slots[next]);
+                        index = next;
+                    }
+                }
+            }
+
+            void Rehash(size_t size) {
+                std::vector<Slot> table(size);
+                table.swap(slots);
+                for (auto& slot : table) {
+                    if (slot.entry) {
+                        Place(std::move(slot));
+                    }
+                }
+            }
+
+            void Place(Slot slot) {
+                const size_t mask = slots.size() - 1;
+                size_t index = slot.hash & mask;
+                while (slots[index].entry) {
+                    index = (index + 1) & mask;
+                }
+                slots[index] = std::move(slot);
+            }
+
+            std::vector<Slot> slots;
+            size_t count = 0;
+        };
+
+        template<typename MethodType>
+        MethodWrapper& Insert(std::string name, MethodType method) {
+            const size_t hash = std::hash<std::string>()(name);
+            if (myTable.Get().Find(name, hash) != NOT_FOUND) {
+                throw std::invalid_argument(name + ": method already added");
+            }
+
+            Slot slot;
+            slot.hash = hash;
+            slot.entry = std::make_shared<MethodEntry>(std::move(name), std::move(method));
+            MethodWrapper& wrapper = slot.entry->method;
+            Change([&](Table& table) {
+                // checked again, another thread may have added it since
+                if (table.Find(slot.entry->name, hash) != NOT_FOUND) {
+                    throw std::invalid_argument(slot.entry->name + ": method already added");
+                }
+                table.Add(std::move(slot));
+            });
+            return wrapper;
+        }
+
+        template<typename ChangeType>
+        void Change(ChangeType change) {
+            if (myConcurrent) {
+                myTable.Update(change);
+            } else {
+                change(myTable.GetMutable());
+            }
+        }
+
+        Snapshot<Table> myTable;
+        bool myConcurrent = false;
+        std::unique_ptr<Metrics> myMetrics;
     };
 
 } // namespace jsonrpc
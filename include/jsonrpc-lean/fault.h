@@ -123,6 +123,30 @@ namespace jsonrpc {
         }
     };
 
+    // A fault returned instead of thrown, by the paths that reject invalid input (Reader::TryGetRequestView,
+    // the parameters of typed methods, MethodWrapper::CheckedMethod): a flood of bad requests then costs
+    // building their error responses rather than unwinding the stack for each of them
+    class FaultStatus {
+    public:
+        FaultStatus() {}
+
+        FaultStatus(const Fault& fault)
+            : myIsFault(true),
+            myFaultCode(fault.GetCode()),
+            myFaultString(fault.GetString()) {
+        }
+
+        explicit operator bool() const { return myIsFault; }
+
+        int32_t GetCode() const { return myFaultCode; }
+        const std::string& GetString() const { return myFaultString; }
+
+    private:
+        bool myIsFault = false;
+        int32_t myFaultCode = 0;
+        std::string myFaultString;
+    };
+
 } // namespace jsonrpc
 
 #endif //JSONRPC_LEAN_FAULT_H
@@ -0,0 +1,236 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_FLATOBJECT_H
+#define JSONRPC_LEAN_FLATOBJECT_H
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace jsonrpc {
+
+    // Members of an object one after the other in a vector, in the order they were added (which is the order
+    // they are written in). Objects are mostly small: up to LINEAR_LIMIT members a name is looked up by
+    // comparing it with each, above that through an index of their positions, hashed by name.
+    // Has the parts of std::unordered_map that objects are used with, but adding or removing a member
+    // invalidates references and iterators to the others, and names must not be changed through iterators.
+    template<typename MappedType>
+    class FlatObject {
+    public:
+        typedef std::string key_type;
+        typedef MappedType mapped_type;
+        typedef std::pair<std::string, MappedType> value_type;
+        typedef typename std::vector<value_type>::iterator iterator;
+        typedef typename std::vector<value_type>::const_iterator const_iterator;
+        typedef size_t size_type;
+
+        static const size_t LINEAR_LIMIT = 16;
+
+        FlatObject() {}
+
+        FlatObject(std::initializer_list<value_type> members) : FlatObject(members.begin(), members.end()) {}
+
+        template<typename IteratorType>
+        FlatObject(IteratorType first, IteratorType last) {
+            for (; first != last; ++first) {
+                emplace(first->first, first->second);
+            }
+        }
+
+        iterator begin() { return myMembers.begin(); }
+        iterator end() { return myMembers.end(); }
+        const_iterator begin() const { return myMembers.begin(); }
+        const_iterator end() const { return myMembers.end(); }
+
+        size_t size() const { return myMembers.size(); }
+        bool empty() const { return myMembers.empty(); }
+        void reserve(size_t size) { myMembers.reserve(size); }
+
+        void clear() {
+            myMembers.clear();
+            myIndex.clear();
+        }
+
+        iterator find(const std::string& name) { return find(name.data(), name.size()); }
+        const_iterator find(const std::string& name) const { return find(name.data(), name.size()); }
+
+        // Without a std::string for the name
+        iterator find(const char* name, size_t size) {
+            return myMembers.begin() + Find(name, size);
+        }
+
+        const_iterator find(const char* name, size_t size) const {
+            return myMembers.begin() + Find(name, size);
+        }
+
+        size_t count(const std::string& name) const { return find(name) != end() ? 1 : 0; }
+
+        MappedType& at(const std::string& name) {
+            auto member = find(name);
+            if (member == end()) {
+                throw std::out_of_range(name + ": no such member");
+            }
+            return member->second;
+        }
+
+        const MappedType& at(const std::string& name) const {
+            auto member = find(name);
+            if (member == end()) {
+                throw std::out_of_range(name + ": no such member");
+            }
+            return member->second;
+        }
+
+        MappedType& operator[](const std::string& name) {
+            return emplace(name, MappedType()).first->second;
+        }
+
+        MappedType& operator[](std::string&& name) {
+            return emplace(std::move(name), MappedType()).first->second;
+        }
+
+        // Like for std::unordered_map, nothing is added if there is a member with that name already
+        template<typename NameType, typename... ArgumentTypes>
+        std::pair<iterator, bool> emplace(NameType&& name, ArgumentTypes&&... arguments) {
+            const std::string& key = name;
+            const size_t position = Find(key.data(), key.size());
+            if (position != myMembers.size()) {
+                return{ myMembers.begin() + position, false };
+            }
+
+            myMembers.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<NameType>(name)),
+                std::forward_as_tuple(std::forward<ArgumentTypes>(arguments)...));
+            if (!myIndex.empty() && myMembers.size() * 2 <= myIndex.size()) {
+                Place(myMembers.size() - 1);
+            } else if (myMembers.size() > LINEAR_LIMIT) {
+                Rehash();
+            }
+            return{ myMembers.end() - 1, true };
+        }
+
+        std::pair<iterator, bool> insert(value_type member) {
+            return emplace(std::move(member.first), std::move(member.second));
+        }
+
+        // Keeps the order of the others
+        iterator erase(const_iterator member) {
+            const size_t position = member - myMembers.begin();
+            myMembers.erase(myMembers.begin() + position);
+            Rehash();
+            return myMembers.begin() + position;
+        }
+
+        size_t erase(const std::string& name) {
+            auto member = find(name);
+            if (member == end()) {
+                return 0;
+            }
+            erase(member);
+            return 1;
+        }
+
+        // The same members with equal values, in any order
+        friend bool operator==(const FlatObject& a, const FlatObject& b) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (auto& member : a) {
+                auto other = b.find(member.first);
+                if (other == b.end() || !(other->second == member.second)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        friend bool operator!=(const FlatObject& a, const FlatObject& b) { return !(a == b); }
+
+    private:
+        // FNV-1a, names are short
+        static size_t Hash(const char* name, size_t size) {
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < size; ++i) {
+                hash = (hash ^ static_cast<unsigned char>(name[i])) * 1099511628211ull;
+            }
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+
+        static bool IsNamed(const value_type& member, const char* name, size_t size) {
+            return member.first.size() == size && memcmp(member.first.data(), name, size) == 0;
+        }
+
+        // Position of the member, size() if there is none
+        size_t Find(const char* name, size_t size) const {
+            if (myIndex.empty()) {
+                for (size_t i = 0; i < myMembers.size(); ++i) {
+                    if (IsNamed(myMembers[i], name, size)) {
+                        return i;
+                    }
+                }
+                return myMembers.size();
+            }
+
+            const size_t mask = myIndex.size() - 1;
+            for (size_t slot = Hash(name, size) & mask; myIndex[slot] != 0; slot = (slot + 1) & mask) {
+                if (IsNamed(myMembers[myIndex[slot] - 1], name, size)) {
+                    return myIndex[slot] - 1;
+                }
+            }
+            return myMembers.size();
+        }
+
+        // Linear probing, slots hold the position plus one and 0 when empty
+        void Place(size_t position) {
+            const size_t mask = myIndex.size() - 1;
+            size_t slot = Hash(myMembers[position].first.data(), myMembers[position].first.size()) & mask;
+            while (myIndex[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            myIndex[slot] = static_cast<uint32_t>(position + 1);
+        }
+
+        // Rebuilds the index for the members there are now, or drops it if they are few enough
+        void Rehash() {
+            myIndex.clear();
+            if (myMembers.size() <= LINEAR_LIMIT) {
+                return;
+            }
+            // at most half full, with room to grow before the next rehash
+            size_t capacity = 64;
+            while (capacity < myMembers.size() * 4) {
+                capacity *= 2;
+            }
+            myIndex.assign(capacity, 0);
+            for (size_t i = 0; i < myMembers.size(); ++i) {
+                Place(i);
+            }
+        }
+
+        std::vector<value_type> myMembers;
+        std::vector<uint32_t> myIndex;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_FLATOBJECT_H
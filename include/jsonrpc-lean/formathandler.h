@@ -20,12 +20,17 @@
 #ifndef JSONRPC_LEAN_FORMATHANDLER_H
 #define JSONRPC_LEAN_FORMATHANDLER_H
 
+#include "compat.h"
+#include "fault.h"
+#include "parselimits.h"
+#include "reader.h"
+
 #include <memory>
 #include <string>
 
 namespace jsonrpc {
 
-    class Reader;
+    class OutputSink;
     class Writer;
 
     class FormatHandler {
@@ -36,7 +41,88 @@ namespace jsonrpc {
         virtual std::string GetContentType() = 0;
         virtual bool UsesId() = 0;
         virtual std::unique_ptr<Reader> CreateReader(const std::string& data) = 0;
+
+        // Reads straight from the caller's buffer; the default implementation copies it into a std::string
+        virtual std::unique_ptr<Reader> CreateReader(const char* data, size_t size) {
+            return CreateReader(std::string(data, size));
+        }
+
+        // May parse in place, modifying data; data[size] must be '\0' and the buffer must outlive the Reader
+        virtual std::unique_ptr<Reader> CreateInsituReader(char* data, size_t size) {
+            return CreateReader(static_cast<const char*>(data), size);
+        }
+
+        // Data that can't be parsed is reported in parseError (and NULL returned) instead of thrown; these
+        // implementations catch what the others throw
+        virtual std::unique_ptr<Reader> CreateReader(const char* data, size_t size, FaultStatus& parseError) {
+            try {
+                return CreateReader(data, size);
+            } catch (const Fault& ex) {
+                parseError = ex;
+                return nullptr;
+            }
+        }
+
+        virtual std::unique_ptr<Reader> CreateInsituReader(char* data, size_t size, FaultStatus& parseError) {
+            try {
+                return CreateInsituReader(data, size);
+            } catch (const Fault& ex) {
+                parseError = ex;
+                return nullptr;
+            }
+        }
+
+        // Pulls the data through read as it parses, without the whole text ever being in memory;
+        // the default implementation reads everything into a std::string first
+        virtual std::unique_ptr<Reader> CreateStreamReader(const Reader::ReadFunction& read) {
+            std::string data;
+            char buffer[4096];
+            for (size_t size; (size = read(buffer, sizeof(buffer))) > 0;) {
+                data.append(buffer, size);
+                if (data.size() > myParseLimits.maximumSize) {
+                    throw InvalidRequestFault(limits::TOO_LARGE);
+                }
+            }
+            return CreateReader(data);
+        }
+
+#ifdef JSONRPC_LEAN_HAS_STRING_VIEW
+        std::unique_ptr<Reader> CreateReader(std::string_view data) {
+            return CreateReader(data.data(), data.size());
+        }
+#endif
+
         virtual std::unique_ptr<Writer> CreateWriter() = 0;
+
+        // Writes into buffer, reusing its capacity, and gives it back through GetData()->ReleaseBuffer();
+        // the default implementation ignores the buffer
+        virtual std::unique_ptr<Writer> CreateWriter(std::string) {
+            return CreateWriter();
+        }
+
+        // Hands the output to sink in chunks while writing (see OutputSink); NULL, by default, for formats
+        // that can't be written out before the whole of it is known
+        virtual std::unique_ptr<Writer> CreateWriter(OutputSink&) {
+            return nullptr;
+        }
+
+        // For the readers created from now on, which refuse what is over them as they parse it
+        void SetParseLimits(const ParseLimits& parseLimits) {
+            myParseLimits = parseLimits;
+            myHasParseLimits = !parseLimits.IsUnlimited();
+        }
+
+        const ParseLimits& GetParseLimits() const { return myParseLimits; }
+
+    protected:
+        // NULL without limits, for readers to parse as fast as they can then
+        const ParseLimits* GetReaderLimits() const {
+            return myHasParseLimits ? &myParseLimits : nullptr;
+        }
+
+    private:
+        ParseLimits myParseLimits;
+        bool myHasParseLimits = false;
     };
 
 } // namespace jsonrpc
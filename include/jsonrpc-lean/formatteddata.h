@@ -19,6 +19,9 @@
 #ifndef JSONRPC_LEAN_REQUEST_DATA_H
 #define JSONRPC_LEAN_REQUEST_DATA_H
 
+#include <cstddef>
+#include <string>
+
 namespace jsonrpc {
 
     class FormattedData {
@@ -28,6 +31,11 @@ namespace jsonrpc {
         // Data
         virtual const char* GetData() = 0;
         virtual size_t GetSize() = 0;
+
+        // Hands the formatted data over as a std::string; the default implementation copies it
+        virtual std::string ReleaseBuffer() {
+            return std::string(GetData(), GetSize());
+        }
     };
 
 } // namespace jsonrpc
@@ -22,6 +22,7 @@
 
 #include "formathandler.h"
 #include "jsonreader.h"
+#include "jsonstreamreader.h"
 #include "jsonwriter.h"
 
 #include <memory>
@@ -47,14 +48,49 @@ namespace jsonrpc {
             return true;
         }
 
+        using FormatHandler::CreateReader;
+
         std::unique_ptr<Reader> CreateReader(const std::string& data) override {
-            return std::unique_ptr<Reader>(std::make_unique<JsonReader>(std::move(data)));
+            return CreateReader(data.data(), data.size());
+        }
+
+        std::unique_ptr<Reader> CreateReader(const char* data, size_t size) override {
+            return std::unique_ptr<Reader>(std::make_unique<JsonReader>(data, size, nullptr, GetReaderLimits()));
+        }
+
+        std::unique_ptr<Reader> CreateInsituReader(char* data, size_t size) override {
+            return std::unique_ptr<Reader>(std::make_unique<JsonReader>(data, size, true, nullptr, GetReaderLimits()));
+        }
+
+        std::unique_ptr<Reader> CreateReader(const char* data, size_t size, FaultStatus& parseError) override {
+            auto reader = std::make_unique<JsonReader>(data, size, &parseError, GetReaderLimits());
+            return parseError ? nullptr : std::unique_ptr<Reader>(std::move(reader));
+        }
+
+        std::unique_ptr<Reader> CreateInsituReader(char* data, size_t size, FaultStatus& parseError) override {
+            auto reader = std::make_unique<JsonReader>(data, size, true, &parseError, GetReaderLimits());
+            return parseError ? nullptr : std::unique_ptr<Reader>(std::move(reader));
+        }
+
+        std::unique_ptr<Reader> CreateStreamReader(const Reader::ReadFunction& read) override {
+            // (not make_unique, which would need DEFAULT_BUFFER_SIZE defined out of the class)
+            return std::unique_ptr<Reader>(new JsonStreamReader(read, nullptr, JsonStreamReader::DEFAULT_BUFFER_SIZE, GetReaderLimits()));
         }
 
+        using FormatHandler::CreateWriter;
+
         std::unique_ptr<Writer> CreateWriter() override {
             return std::unique_ptr<Writer>(std::make_unique<JsonWriter>());
         }
 
+        std::unique_ptr<Writer> CreateWriter(std::string buffer) override {
+            return std::unique_ptr<Writer>(std::make_unique<JsonWriter>(std::move(buffer)));
+        }
+
+        std::unique_ptr<Writer> CreateWriter(OutputSink& sink) override {
+            return std::unique_ptr<Writer>(std::make_unique<JsonWriter>(sink));
+        }
+
     private:
 
     };
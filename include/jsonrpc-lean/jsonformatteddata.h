@@ -20,35 +20,92 @@
 #define JSONRPC_LEAN_JSONREQUESTDATA_H
 
 #include "formatteddata.h"
+#include "outputsink.h"
 
 #define RAPIDJSON_NO_SIZETYPEDEFINE
 namespace rapidjson { typedef ::std::size_t SizeType; }
 
 #include <rapidjson/writer.h>
-#include <rapidjson/stringbuffer.h>
+
+#include <string>
 
 namespace jsonrpc {
 
+    // rapidjson output stream appending to a std::string, so that a buffer can be handed in and out
+    // with the capacity it already has (see OutputBuffer). With a sink, Flush hands the string to it, and
+    // so does Put each time the string reaches the sink's chunk size: even a single string of several MB
+    // (a base64 attachment...) goes out a chunk at a time.
+    class JsonStringStream {
+    public:
+        typedef char Ch;
+
+        explicit JsonStringStream(std::string& string) : myString(&string) {}
+
+        JsonStringStream(std::string& string, OutputSink& sink) : myString(&string), mySink(&sink), myChunkSize(sink.GetChunkSize()) {}
+
+        void Put(Ch c) {
+            myString->push_back(c);
+            if (myString->size() >= myChunkSize) {
+                Flush();
+            }
+        }
+
+        void Flush() {
+            if (mySink != nullptr && !myString->empty()) {
+                mySink->Append(myString->data(), myString->size());
+                myString->clear();
+            }
+        }
+
+    private:
+        std::string* myString;
+        OutputSink* mySink = nullptr;
+        // never reached without a sink
+        size_t myChunkSize = static_cast<size_t>(-1);
+    };
+
     class JsonFormattedData final : public FormattedData {
     public:
-        JsonFormattedData() : Writer(myStringBuffer) {
+        JsonFormattedData() : Writer(myStream) {
+
+        }
+
+        // Writes into buffer (after clearing it), reusing its capacity
+        explicit JsonFormattedData(std::string buffer) : myBuffer(std::move(buffer)), Writer(myStream) {
+            myBuffer.clear();
+        }
 
+        // Hands the output to sink as it is written, and is left empty
+        explicit JsonFormattedData(OutputSink& sink) : myStream(myBuffer, sink), Writer(myStream) {
+            myBuffer.reserve(sink.GetChunkSize());
         }
 
         const char* GetData() override {
-            return myStringBuffer.GetString();
+            return myBuffer.c_str();
         }
 
         size_t GetSize() override {
-            return myStringBuffer.GetSize();
+            return myBuffer.size();
         }
 
-        rapidjson::Writer<rapidjson::StringBuffer> Writer;
+        std::string ReleaseBuffer() override {
+            std::string buffer(std::move(myBuffer));
+            myBuffer = std::string();
+            return buffer;
+        }
+
+        // Hands what is left to the sink, if there is one
+        void Flush() {
+            myStream.Flush();
+        }
 
     private:
+        // before Writer, which is constructed with myStream
+        std::string myBuffer;
+        JsonStringStream myStream{ myBuffer };
 
-        rapidjson::StringBuffer myStringBuffer;
-        
+    public:
+        rapidjson::Writer<JsonStringStream> Writer;
     };
 
 } // namespace jsonrpc
@@ -21,89 +21,199 @@
 #define JSONRPC_LEAN_JSONREADER_H
 
 #include "reader.h"
+#include "compat.h"
 #include "fault.h"
 #include "json.h"
+#include "parselimits.h"
 #include "request.h"
 #include "response.h"
 #include "util.h"
 #include "value.h"
+#include "valueview.h"
 
 #define RAPIDJSON_NO_SIZETYPEDEFINE
 namespace rapidjson { typedef ::std::size_t SizeType; }
 
 #include <rapidjson/document.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
 #include <string>
 
 namespace jsonrpc {
 
     class JsonReader final : public Reader {
     public:
-        JsonReader(const std::string& data) {
-            myDocument.Parse(data.c_str());
-            if (myDocument.HasParseError()) {
-                throw ParseErrorFault(
-                    "Parse error: " + std::to_string(myDocument.GetParseError()));
+        JsonReader(const std::string& data) : JsonReader(data.data(), data.size()) {
+        }
+
+        JsonReader(const char* data, size_t size) : JsonReader(data, size, nullptr) {
+        }
+
+        // A parse error is set in parseError instead of thrown, the reader must not be used then. Over limits,
+        // the error is an InvalidRequestFault.
+        JsonReader(const char* data, size_t size, FaultStatus* parseError, const ParseLimits* limits = nullptr) {
+            if (limits == nullptr) {
+                myDocument.Parse(data, size);
+                CheckParseError(parseError);
+            } else if (CheckSize(size, *limits, parseError)) {
+                rapidjson::MemoryStream stream(data, size);
+                ParseLimited<rapidjson::kParseDefaultFlags>(stream, *limits, parseError);
             }
         }
 
+        // With insitu, strings are decoded inside data itself instead of being copied into the document:
+        // data[size] must be '\0', and the buffer is modified and must outlive this reader
+        JsonReader(char* data, size_t size, bool insitu, FaultStatus* parseError = nullptr, const ParseLimits* limits = nullptr) {
+            assert(!insitu || data[size] == '\0');
+            if (limits != nullptr) {
+                if (!CheckSize(size, *limits, parseError)) {
+                    return;
+                }
+                if (insitu) {
+                    rapidjson::InsituStringStream stream(data);
+                    ParseLimited<rapidjson::kParseInsituFlag>(stream, *limits, parseError);
+                } else {
+                    rapidjson::MemoryStream stream(data, size);
+                    ParseLimited<rapidjson::kParseDefaultFlags>(stream, *limits, parseError);
+                }
+                return;
+            }
+            if (insitu) {
+                myDocument.ParseInsitu(data);
+            } else {
+                myDocument.Parse(data, size);
+            }
+            CheckParseError(parseError);
+        }
+
+#ifdef JSONRPC_LEAN_HAS_STRING_VIEW
+        JsonReader(std::string_view data) : JsonReader(data.data(), data.size()) {
+        }
+
+        JsonReader(const char* data) : JsonReader(data, strlen(data)) {
+        }
+#endif
+
         // Reader
         Request GetRequest() override {
-            if (!myDocument.IsObject()) {
+            return Detached(GetRequestView());
+        }
+
+        Request GetRequestView() override {
+            return GetRequest(myDocument);
+        }
+
+        Request TryGetRequestView(FaultStatus& fault) override {
+            return ReadRequest(myDocument, fault);
+        }
+
+        bool IsBatch() override {
+            return myDocument.IsArray();
+        }
+
+        size_t GetBatchSize() override {
+            return myDocument.IsArray() ? myDocument.Size() : 0;
+        }
+
+        Request GetBatchRequest(size_t index) override {
+            return Detached(GetBatchRequestView(index));
+        }
+
+        Request GetBatchRequestView(size_t index) override {
+            if (index >= GetBatchSize()) {
                 throw InvalidRequestFault();
             }
+            return GetRequest(myDocument[index]);
+        }
 
-            ValidateJsonrpcVersion();
+        Request TryGetBatchRequestView(size_t index, FaultStatus& fault) override {
+            if (index >= GetBatchSize()) {
+                fault = InvalidRequestFault();
+                return Request(std::string(), ValueView(), Value());
+            }
+            return ReadRequest(myDocument[index], fault);
+        }
 
-            auto method = myDocument.FindMember(json::METHOD_NAME);
-            if (method == myDocument.MemberEnd() || !method->value.IsString()) {
+        Response GetResponse() override {
+            return GetResponse(myDocument);
+        }
+
+        Response GetBatchResponse(size_t index) override {
+            if (index >= GetBatchSize()) {
                 throw InvalidRequestFault();
             }
+            return GetResponse(myDocument[index]);
+        }
 
-            Request::Parameters parameters;
-            auto params = myDocument.FindMember(json::PARAMS_NAME);
-            if (params != myDocument.MemberEnd()) {
-                if (!params->value.IsArray()) {
-                    throw InvalidRequestFault();
-                }
+        Value GetValue() override {
+            return GetValue(myDocument);
+        }
 
-                for (auto param = params->value.Begin(); param != params->value.End();
-                    ++param) {
-                    parameters.emplace_back(GetValue(*param));
-                }
+    private:
+        void CheckParseError(FaultStatus* parseError) const {
+            if (myDocument.HasParseError()) {
+                Fail(ParseErrorFault("Parse error: " + std::to_string(myDocument.GetParseError())), parseError);
             }
+        }
 
-            auto id = myDocument.FindMember(json::ID_NAME);
-            if (id == myDocument.MemberEnd()) {
-                // Notification
-                return Request(method->value.GetString(), std::move(parameters), false);
+        static bool CheckSize(size_t size, const ParseLimits& limits, FaultStatus* parseError) {
+            ParseLimitChecker checker(limits);
+            if (!checker.Size(size)) {
+                Fail(checker.GetFault(), parseError);
+                return false;
             }
+            return true;
+        }
 
-            return Request(method->value.GetString(), std::move(parameters),
-                GetId(id->value));
+        // Through the limits into myDocument, with the iterative parser so that nesting doesn't use the stack
+        template<unsigned flags, typename StreamType>
+        void ParseLimited(StreamType& stream, const ParseLimits& limits, FaultStatus* parseError) {
+            ParseLimitChecker checker(limits);
+            rapidjson::Reader reader;
+            auto generator = [&](rapidjson::Document& document) {
+                LimitedHandler<rapidjson::Document> handler(document, checker);
+                return !reader.Parse<flags | rapidjson::kParseIterativeFlag>(stream, handler).IsError();
+            };
+            myDocument.Populate(generator);
+            if (checker.IsExceeded()) {
+                Fail(checker.GetFault(), parseError);
+            } else if (reader.HasParseError()) {
+                Fail(ParseErrorFault("Parse error: " + std::to_string(reader.GetParseErrorCode())), parseError);
+            }
         }
 
-        Response GetResponse() override {
-            if (!myDocument.IsObject()) {
+        template<typename FaultType>
+        static void Fail(const FaultType& fault, FaultStatus* parseError) {
+            if (parseError == nullptr) {
+                throw fault;
+            }
+            *parseError = fault;
+        }
+
+        Response GetResponse(const rapidjson::Value& response) const {
+            if (!response.IsObject()) {
                 throw InvalidRequestFault();
             }
 
-            ValidateJsonrpcVersion();
+            if (!HasJsonrpcVersion(response)) {
+                throw InvalidRequestFault();
+            }
 
-            auto id = myDocument.FindMember(json::ID_NAME);
-            if (id == myDocument.MemberEnd()) {
+            auto id = response.FindMember(json::ID_NAME);
+            if (id == response.MemberEnd()) {
                 throw InvalidRequestFault();
             }
 
-            auto result = myDocument.FindMember(json::RESULT_NAME);
-            auto error = myDocument.FindMember(json::ERROR_NAME);
+            auto result = response.FindMember(json::RESULT_NAME);
+            auto error = response.FindMember(json::ERROR_NAME);
 
-            if (result != myDocument.MemberEnd()) {
-                if (error != myDocument.MemberEnd()) {
+            if (result != response.MemberEnd()) {
+                if (error != response.MemberEnd()) {
                     throw InvalidRequestFault();
                 }
                 return Response(GetValue(result->value), GetId(id->value));
-            } else if (error != myDocument.MemberEnd()) {
-                if (result != myDocument.MemberEnd()) {
+            } else if (error != response.MemberEnd()) {
+                if (result != response.MemberEnd()) {
                     throw InvalidRequestFault();
                 }
                 if (!error->value.IsObject()) {
@@ -125,21 +235,70 @@ namespace jsonrpc {
             }
         }
 
-        Value GetValue() override {
-            return GetValue(myDocument);
+        static Request Detached(Request request) {
+            request.DetachParameters();
+            return request;
         }
 
-    private:
-        void ValidateJsonrpcVersion() const {
-            auto jsonrpc = myDocument.FindMember(json::JSONRPC_NAME);
-            if (jsonrpc == myDocument.MemberEnd()
-                || !jsonrpc->value.IsString()
-                || strcmp(jsonrpc->value.GetString(), json::JSONRPC_VERSION_2_0) != 0) {
+        Request GetRequest(const rapidjson::Value& request) const {
+            FaultStatus fault;
+            Request result = ReadRequest(request, fault);
+            if (fault) {
                 throw InvalidRequestFault();
             }
+            return result;
         }
 
-        Value GetValue(const rapidjson::Value& value) const {
+        // Without throwing: anything wrong with the request is an invalid request, set in fault
+        Request ReadRequest(const rapidjson::Value& request, FaultStatus& fault) const {
+            if (!request.IsObject() || !HasJsonrpcVersion(request)) {
+                return InvalidRequest(fault);
+            }
+
+            auto method = request.FindMember(json::METHOD_NAME);
+            if (method == request.MemberEnd() || !method->value.IsString()) {
+                return InvalidRequest(fault);
+            }
+
+            // The parameters stay in myDocument and are only converted to Values when they are used. By name
+            // (an object) they are put in order by the method, see MethodWrapper::SetParameterNames.
+            ValueView parameters;
+            auto params = request.FindMember(json::PARAMS_NAME);
+            if (params != request.MemberEnd()) {
+                if (!params->value.IsArray() && !params->value.IsObject()) {
+                    return InvalidRequest(fault);
+                }
+
+                parameters = ValueView(&params->value, GetViewAccessor());
+            }
+
+            auto id = request.FindMember(json::ID_NAME);
+            if (id == request.MemberEnd()) {
+                // Notification
+                return Request(method->value.GetString(), parameters, false);
+            }
+
+            Value requestId;
+            if (!ReadId(id->value, requestId)) {
+                return InvalidRequest(fault);
+            }
+            return Request(method->value.GetString(), parameters,
+                std::move(requestId));
+        }
+
+        static Request InvalidRequest(FaultStatus& fault) {
+            fault = InvalidRequestFault();
+            return Request(std::string(), ValueView(), Value());
+        }
+
+        static bool HasJsonrpcVersion(const rapidjson::Value& object) {
+            auto jsonrpc = object.FindMember(json::JSONRPC_NAME);
+            return jsonrpc != object.MemberEnd()
+                && jsonrpc->value.IsString()
+                && strcmp(jsonrpc->value.GetString(), json::JSONRPC_VERSION_2_0) == 0;
+        }
+
+        static Value GetValue(const rapidjson::Value& value) {
             switch (value.GetType()) {
             case rapidjson::kNullType:
                 return Value();
@@ -148,9 +307,13 @@ namespace jsonrpc {
                 return Value(value.GetBool());
             case rapidjson::kObjectType: {
                 Value::Struct data;
+#ifdef JSONRPC_LEAN_FLAT_OBJECT
+                // one allocation for all the members (a hash map would choose its bucket count from this)
+                data.reserve(value.MemberCount());
+#endif
                 for (auto it = value.MemberBegin(); it != value.MemberEnd(); ++it) {
                     std::string name(it->name.GetString(), it->name.GetStringLength());
-                    data.emplace(name, GetValue(it->value));
+                    data.emplace(std::move(name), GetValue(it->value));
                 }
                 return Value(std::move(data));
             }
@@ -191,21 +354,70 @@ namespace jsonrpc {
             throw InternalErrorFault();
         }
 
+        static const rapidjson::Value& AsNode(const void* node) { return *static_cast<const rapidjson::Value*>(node); }
+
+        static const ValueView::Accessor& GetViewAccessor() {
+            static const ValueView::Accessor accessor = {
+                [](const void* node) {
+                    auto& value = AsNode(node);
+                    switch (value.GetType()) {
+                    case rapidjson::kNullType: return Value::TYPE_NULL;
+                    case rapidjson::kFalseType:
+                    case rapidjson::kTrueType: return Value::TYPE_BOOLEAN;
+                    case rapidjson::kObjectType: return Value::TYPE_OBJECT;
+                    case rapidjson::kArrayType: return Value::TYPE_ARRAY;
+                    case rapidjson::kStringType: return Value::TYPE_STRING;
+                    case rapidjson::kNumberType: return !value.IsDouble() && value.IsInt() ? Value::TYPE_INT32 : Value::TYPE_DOUBLE;
+                    }
+                    return Value::TYPE_UNDEFINED;
+                },
+                [](const void* node) { return AsNode(node).GetBool(); },
+                [](const void* node) { return static_cast<int32_t>(AsNode(node).GetInt()); },
+                [](const void* node) { return AsNode(node).GetDouble(); },
+                [](const void* node, size_t& size) { size = AsNode(node).GetStringLength(); return AsNode(node).GetString(); },
+                [](const void* node) { return static_cast<size_t>(AsNode(node).IsArray() ? AsNode(node).Size() : AsNode(node).MemberCount()); },
+                [](const void* node, size_t index) { return ValueView(&AsNode(node)[index], GetViewAccessor()); },
+                [](const void* node, const char* name, size_t nameSize) {
+                    auto& value = AsNode(node);
+                    for (auto it = value.MemberBegin(); it != value.MemberEnd(); ++it) {
+                        if (it->name.GetStringLength() == nameSize && memcmp(it->name.GetString(), name, nameSize) == 0) {
+                            return ValueView(&it->value, GetViewAccessor());
+                        }
+                    }
+                    return ValueView();
+                },
+                [](const void* node, ValueView::MemberCallback callback, void* context) {
+                    auto& value = AsNode(node);
+                    for (auto it = value.MemberBegin(); it != value.MemberEnd(); ++it) {
+                        callback(context, it->name.GetString(), it->name.GetStringLength(), ValueView(&it->value, GetViewAccessor()));
+                    }
+                },
+                [](const void* node) { return GetValue(AsNode(node)); }
+            };
+            return accessor;
+        }
+
         Value GetId(const rapidjson::Value& id) const {
+            Value result;
+            if (!ReadId(id, result)) {
+                throw InvalidRequestFault();
+            }
+            return result;
+        }
+
+        static bool ReadId(const rapidjson::Value& id, Value& result) {
             if (id.IsString()) {
-                return id.GetString();
+                result = id.GetString();
             } else if (id.IsInt()) {
-                return id.GetInt();
+                result = id.GetInt();
             } else if (id.IsInt64()) {
-                return id.GetInt64();
-            } else if (id.IsNull()) {
-                return{};
+                result = id.GetInt64();
+            } else if (!id.IsNull()) {
+                return false;
             }
-
-            throw InvalidRequestFault();
+            return true;
         }
 
-        std::string myData;
         rapidjson::Document myDocument;
     };
 
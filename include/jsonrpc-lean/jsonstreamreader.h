@@ -0,0 +1,224 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_JSONSTREAMREADER_H
+#define JSONRPC_LEAN_JSONSTREAMREADER_H
+
+#include "fault.h"
+#include "json.h"
+#include "parselimits.h"
+#include "value.h"
+#include "valuereader.h"
+
+#define RAPIDJSON_NO_SIZETYPEDEFINE
+namespace rapidjson { typedef ::std::size_t SizeType; }
+
+#include <rapidjson/reader.h>
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace jsonrpc {
+
+    // rapidjson input stream pulling its data in chunks from a Reader::ReadFunction, so only one
+    // chunk of the raw text is ever held in memory (same idea as rapidjson::FileReadStream). With a checker,
+    // the data ends where it gets over the size limit.
+    class JsonReadStream {
+    public:
+        typedef char Ch;
+
+        JsonReadStream(const Reader::ReadFunction& read, size_t bufferSize, ParseLimitChecker* checker = nullptr)
+            : myRead(read), myBuffer(bufferSize > 1 ? bufferSize : 2), myChecker(checker) {
+            Fill();
+        }
+
+        Ch Peek() const { return *myCurrent; }
+        Ch Take() {
+            Ch c = *myCurrent;
+            if (c != '\0' && ++myCurrent == myEnd) {
+                Fill();
+            }
+            return c;
+        }
+        size_t Tell() const { return myCount + static_cast<size_t>(myCurrent - myBuffer.data()); }
+
+        // Only needed by insitu parsing, which a stream can't do
+        Ch* PutBegin() { assert(false); return nullptr; }
+        void Put(Ch) { assert(false); }
+        void Flush() { assert(false); }
+        size_t PutEnd(Ch*) { assert(false); return 0; }
+
+    private:
+        void Fill() {
+            if (myEnd != nullptr) {
+                myCount += static_cast<size_t>(myEnd - myBuffer.data());
+            }
+            size_t size = myEof ? 0 : myRead(myBuffer.data(), myBuffer.size() - 1);
+            if (myChecker != nullptr && !myChecker->Size(myCount + size)) {
+                size = 0;
+            }
+            if (size == 0) {
+                // the '\0' is what tells rapidjson the document is over
+                myEof = true;
+            }
+            myBuffer[size] = '\0';
+            myCurrent = myBuffer.data();
+            myEnd = myBuffer.data() + (size > 0 ? size : 1);
+        }
+
+        const Reader::ReadFunction& myRead;
+        std::vector<char> myBuffer;
+        ParseLimitChecker* myChecker;
+        char* myCurrent = nullptr;
+        char* myEnd = nullptr;
+        size_t myCount = 0;
+        bool myEof = false;
+    };
+
+    // Reader built on rapidjson's SAX parser: the text is read in chunks and turned straight into Values,
+    // without a rapidjson::Document in between, so the memory needed is about the size of the Values.
+    // Parameters are moved into the requests rather than copied out of the reader. The constructor reads
+    // the whole input; requests and responses are only taken from the reader once it is all parsed.
+    class JsonStreamReader final : public ValueReader {
+    public:
+        // Called with each element of the "params" array of a (non batch) request as soon as it has been
+        // read; the element is then not kept, and the request read afterwards has no parameters. For callers
+        // handling the parameters themselves: FormatHandler::CreateStreamReader (so Server::HandleRequestStream)
+        // never passes one, since the dispatched method would get none.
+        typedef std::function<void(size_t index, Value&& parameter)> ParameterHandler;
+
+        static const size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+        // Over limits, an InvalidRequestFault is thrown as soon as they are exceeded
+        JsonStreamReader(const ReadFunction& read, ParameterHandler parameterHandler = nullptr, size_t bufferSize = DEFAULT_BUFFER_SIZE,
+            const ParseLimits* limits = nullptr)
+            : myParameterHandler(std::move(parameterHandler)) {
+            rapidjson::Reader reader;
+            if (limits == nullptr) {
+                JsonReadStream stream(read, bufferSize);
+                reader.Parse<rapidjson::kParseDefaultFlags>(stream, *this);
+            } else {
+                // iterative, so that nesting doesn't use the stack
+                ParseLimitChecker checker(*limits);
+                JsonReadStream stream(read, bufferSize, &checker);
+                LimitedHandler<JsonStreamReader> handler(*this, checker);
+                reader.Parse<rapidjson::kParseIterativeFlag>(stream, handler);
+                if (checker.IsExceeded()) {
+                    throw checker.GetFault();
+                }
+            }
+            if (reader.HasParseError()) {
+                throw ParseErrorFault(
+                    "Parse error: " + std::to_string(reader.GetParseErrorCode()));
+            }
+        }
+
+        // SAX handler, called by rapidjson::Reader while parsing
+        bool Null() { return Add(Value()); }
+        bool Bool(bool value) { return Add(Value(value)); }
+        bool Int(int value) { return Add(Value(value)); }
+        bool Uint(unsigned value) { return Add(Value(static_cast<int64_t>(value))); }
+        bool Int64(int64_t value) { return Add(Value(value)); }
+        bool Uint64(uint64_t value) {
+            return Add(value > static_cast<uint64_t>(INT64_MAX) && IsId() ? InvalidId() : Value(static_cast<double>(value)));
+        }
+        bool Double(double value) { return Add(IsId() ? InvalidId() : Value(value)); }
+        bool RawNumber(const char*, rapidjson::SizeType, bool) { return false; }
+
+        bool String(const char* value, rapidjson::SizeType length, bool) {
+            std::string str(value, length);
+            const bool binary = str.find('\0') != std::string::npos;
+            return binary ? Add(Value(std::move(str), binary)) : Add(Value(std::move(str)));
+        }
+
+        bool StartObject() {
+            myStack.emplace_back(Value::Object());
+            return true;
+        }
+
+        bool Key(const char* name, rapidjson::SizeType length, bool) {
+            myStack.back().key.assign(name, length);
+            return true;
+        }
+
+        bool EndObject(rapidjson::SizeType) { return End(); }
+
+        bool StartArray() {
+            const bool streamed = myParameterHandler && myStack.size() == 1
+                && myStack[0].value.IsObject() && myStack[0].key == json::PARAMS_NAME;
+            myStack.emplace_back(Value::Array());
+            myStack.back().streamed = streamed;
+            return true;
+        }
+
+        bool EndArray(rapidjson::SizeType) { return End(); }
+
+    private:
+        struct Frame {
+            explicit Frame(Value container) : value(std::move(container)) {}
+
+            Value value;
+            std::string key;
+            bool streamed = false;
+            size_t count = 0;
+        };
+
+        // The value about to be added is the id of a request or response, at the top or in a batch
+        bool IsId() const {
+            const size_t depth = myStack.size();
+            return (depth == 1 || (depth == 2 && myStack[0].value.IsArray()))
+                && myStack.back().value.IsObject() && myStack.back().key == json::ID_NAME;
+        }
+
+        // Ids that JsonReader refuses (1.0, or over the 64 bit integers) would be doubles like the integers
+        // past 32 bits, which ValueReader::GetId accepts; a null (JSON null is read as undefined) it refuses
+        static Value InvalidId() { return Value(nullptr); }
+
+        bool Add(Value value) {
+            if (myStack.empty()) {
+                myDocument = std::move(value);
+                return true;
+            }
+
+            auto& frame = myStack.back();
+            if (frame.streamed) {
+                myParameterHandler(frame.count++, std::move(value));
+            } else if (frame.value.IsArray()) {
+                frame.value.AsArray().emplace_back(std::move(value));
+            } else {
+                frame.value.AsObject()[frame.key] = std::move(value);
+            }
+            return true;
+        }
+
+        bool End() {
+            Value value(std::move(myStack.back().value));
+            myStack.pop_back();
+            return Add(std::move(value));
+        }
+
+        ParameterHandler myParameterHandler;
+        std::vector<Frame> myStack;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_JSONSTREAMREADER_H
@@ -29,9 +29,13 @@
 #define RAPIDJSON_NO_SIZETYPEDEFINE
 namespace rapidjson { typedef ::std::size_t SizeType; }
 
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/stringbuffer.h>
 
+#include <cassert>
+
 namespace jsonrpc {
 
     class JsonWriter final : public Writer {
@@ -39,6 +43,14 @@ namespace jsonrpc {
         JsonWriter() : myRequestData(new JsonFormattedData()) {
         }
 
+        // Writes into buffer, reusing its capacity; get it back with GetData()->ReleaseBuffer()
+        explicit JsonWriter(std::string buffer) : myRequestData(std::make_shared<JsonFormattedData>(std::move(buffer))) {
+        }
+
+        // Hands the output to sink in chunks as it is written; GetData() is then empty
+        explicit JsonWriter(OutputSink& sink) : myRequestData(std::make_shared<JsonFormattedData>(sink)) {
+        }
+
         // Writer
         std::shared_ptr<FormattedData> GetData() override {
             return std::static_pointer_cast<FormattedData>(myRequestData);
@@ -49,7 +61,15 @@ namespace jsonrpc {
         }
 
         void EndDocument() override {
-            // Empty
+            myRequestData->Flush();
+        }
+
+        void StartBatch() override {
+            myRequestData->Writer.StartArray();
+        }
+
+        void EndBatch() override {
+            myRequestData->Writer.EndArray();
         }
 
         void StartRequest(const std::string& methodName, const Value& id) override {
@@ -174,7 +194,27 @@ namespace jsonrpc {
         }
 
         void Write(const tm& value) override {
-            Write(util::FormatIso8601DateTime(value));
+            char str[util::MAXIMUM_DATE_TIME_SIZE];
+            myRequestData->Writer.String(str, util::FormatIso8601DateTime(value, str), true);
+        }
+
+        void WriteRaw(const char* data, size_t size) override {
+            // the type only matters to rapidjson for a value written as the whole document
+            myRequestData->Writer.RawValue(data, size, rapidjson::kObjectType);
+        }
+
+        void WriteRawJson(const char* data, size_t size) override {
+            // the text goes out unchecked in release builds, a broken one would break the whole response
+            assert(IsValidJson(data, size));
+            myRequestData->Writer.RawValue(data, size, rapidjson::kObjectType);
+        }
+
+        // Whether data is exactly one JSON value (surrounding whitespace aside)
+        static bool IsValidJson(const char* data, size_t size) {
+            rapidjson::MemoryStream stream(data, size);
+            rapidjson::BaseReaderHandler<> handler;
+            rapidjson::Reader reader;
+            return !reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler).IsError();
         }
 
     private:
@@ -196,6 +236,17 @@ namespace jsonrpc {
         std::shared_ptr<JsonFormattedData> myRequestData;
     };
 
+    // Calls write(writer) with the writer's static type when it is a JsonWriter, so that templated
+    // Value/Request/Response::Write bind (and can inline) every call instead of going through Writer
+    template<typename WriteType>
+    inline void WriteStatic(Writer& writer, WriteType write) {
+        if (auto jsonWriter = dynamic_cast<JsonWriter*>(&writer)) {
+            write(*jsonWriter);
+        } else {
+            write(writer);
+        }
+    }
+
 } // namespace jsonrpc
 
 #endif // JSONRPC_LEAN_JSONWRITER_H
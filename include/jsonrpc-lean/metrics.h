@@ -0,0 +1,315 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_METRICS_H
+#define JSONRPC_LEAN_METRICS_H
+
+#include "value.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jsonrpc {
+
+    // Totals a Histogram had when it was read
+    struct HistogramReport {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        // buckets[0] counts zeroes, buckets[i] the values from 2^(i-1) to 2^i - 1
+        std::vector<uint64_t> buckets;
+
+        double GetMean() const { return count == 0 ? 0 : static_cast<double>(sum) / count; }
+
+        // Upper bound of the bucket holding the value below which the fraction q of the values fall
+        uint64_t GetPercentile(double q) const {
+            const uint64_t rank = static_cast<uint64_t>(q * count);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets.size(); ++i) {
+                seen += buckets[i];
+                if (seen > rank || seen == count) {
+                    return i == 0 ? 0 : i >= 64 ? UINT64_MAX : (uint64_t(1) << i) - 1;
+                }
+            }
+            return 0;
+        }
+
+        Value ToValue() const {
+            Value::Object object;
+            object["count"] = static_cast<int64_t>(count);
+            object["mean"] = GetMean();
+            object["p50"] = static_cast<int64_t>(GetPercentile(0.5));
+            object["p90"] = static_cast<int64_t>(GetPercentile(0.9));
+            object["p99"] = static_cast<int64_t>(GetPercentile(0.99));
+            object["max"] = static_cast<int64_t>(GetPercentile(1));
+            return Value(std::move(object));
+        }
+    };
+
+    // Power of two histogram that any number of threads can record into without locks: each thread counts in
+    // one of a few shards with relaxed atomics, so threads rarely share a cache line, and reading adds them up.
+    class Histogram {
+    public:
+        static const size_t BUCKET_COUNT = 65;
+
+        Histogram() {
+            for (auto& shard : myShards) {
+                for (auto& bucket : shard.buckets) {
+                    bucket.store(0, std::memory_order_relaxed);
+                }
+                shard.sum.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        Histogram(const Histogram&) = delete;
+        Histogram& operator=(const Histogram&) = delete;
+
+        void Record(uint64_t value) {
+            Shard& shard = myShards[GetShardIndex()];
+            shard.buckets[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+            shard.sum.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        // Not a consistent cut: values recorded meanwhile may be partly counted
+        HistogramReport GetReport() const {
+            HistogramReport report;
+            report.buckets.assign(BUCKET_COUNT, 0);
+            for (auto& shard : myShards) {
+                for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                    const uint64_t count = shard.buckets[i].load(std::memory_order_relaxed);
+                    report.buckets[i] += count;
+                    report.count += count;
+                }
+                report.sum += shard.sum.load(std::memory_order_relaxed);
+            }
+            return report;
+        }
+
+    private:
+        static const size_t SHARD_COUNT = 16;
+
+        struct Shard {
+            std::atomic<uint64_t> buckets[BUCKET_COUNT];
+            std::atomic<uint64_t> sum;
+            // keeps the next shard off the last cache line of this one
+            char padding[64];
+        };
+
+        static size_t GetBucket(uint64_t value) {
+#if defined(__GNUC__)
+            return value == 0 ? 0 : 64 - __builtin_clzll(value);
+#else
+            size_t bucket = 0;
+            for (; value != 0; value >>= 1) {
+                ++bucket;
+            }
+            return bucket;
+#endif
+        }
+
+        // Threads are spread over the shards in the order they first record anything
+        static size_t GetShardIndex() {
+            static std::atomic<size_t> next(0);
+            static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+            return index;
+        }
+
+        Shard myShards[SHARD_COUNT];
+    };
+
+    // What was measured for one method
+    struct MethodReport {
+        std::string name;
+        uint64_t calls = 0;
+        uint64_t faults = 0;
+        // fault code and count, for the first codes seen; faults beyond those are only in the total
+        std::vector<std::pair<int32_t, uint64_t>> faultCodes;
+        // from the call to the response, in nanoseconds
+        HistogramReport latency;
+    };
+
+    // Calls, faults by code and latency of one method
+    class MethodMetrics {
+    public:
+        MethodMetrics() {
+            for (auto& counter : myFaultCodes) {
+                counter.code.store(EMPTY, std::memory_order_relaxed);
+                counter.count.store(0, std::memory_order_relaxed);
+            }
+            myFaults.store(0, std::memory_order_relaxed);
+        }
+
+        MethodMetrics(const MethodMetrics&) = delete;
+        MethodMetrics& operator=(const MethodMetrics&) = delete;
+
+        void RecordCall(uint64_t nanoseconds) {
+            myLatency.Record(nanoseconds);
+        }
+
+        void RecordFault(int32_t code) {
+            myFaults.fetch_add(1, std::memory_order_relaxed);
+            // a method fails with a handful of codes, claimed in a slot each the first time they are seen
+            for (auto& counter : myFaultCodes) {
+                int64_t current = counter.code.load(std::memory_order_relaxed);
+                if (current == EMPTY && counter.code.compare_exchange_strong(current, code, std::memory_order_relaxed)) {
+                    current = code;
+                }
+                if (current == code) {
+                    counter.count.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
+
+        MethodReport GetReport(std::string name) const {
+            MethodReport report;
+            report.name = std::move(name);
+            report.latency = myLatency.GetReport();
+            report.calls = report.latency.count;
+            report.faults = myFaults.load(std::memory_order_relaxed);
+            for (auto& counter : myFaultCodes) {
+                const int64_t code = counter.code.load(std::memory_order_relaxed);
+                if (code != EMPTY) {
+                    report.faultCodes.emplace_back(static_cast<int32_t>(code), counter.count.load(std::memory_order_relaxed));
+                }
+            }
+            return report;
+        }
+
+    private:
+        static const int64_t EMPTY = INT64_MIN;
+
+        struct FaultCounter {
+            std::atomic<int64_t> code;
+            std::atomic<uint64_t> count;
+        };
+
+        Histogram myLatency;
+        std::atomic<uint64_t> myFaults;
+        FaultCounter myFaultCodes[8];
+    };
+
+    // Everything Dispatcher::GetMetricsReport gathered
+    struct MetricsReport {
+        std::vector<MethodReport> methods;
+        // calls to methods that don't exist
+        uint64_t unknownMethodCalls = 0;
+        // times in nanoseconds and sizes in bytes, recorded by the Server
+        HistogramReport parseTime;
+        HistogramReport serialiseTime;
+        HistogramReport requestSize;
+        HistogramReport responseSize;
+
+        // As answered by the method of Dispatcher::AddMetricsMethod
+        Value ToValue() const {
+            Value::Object methodsObject;
+            for (auto& method : methods) {
+                Value::Object faultCodes;
+                for (auto& fault : method.faultCodes) {
+                    faultCodes[std::to_string(fault.first)] = static_cast<int64_t>(fault.second);
+                }
+
+                Value::Object methodObject;
+                methodObject["calls"] = static_cast<int64_t>(method.calls);
+                methodObject["faults"] = static_cast<int64_t>(method.faults);
+                methodObject["faultCodes"] = std::move(faultCodes);
+                methodObject["latency"] = method.latency.ToValue();
+                methodsObject[method.name] = std::move(methodObject);
+            }
+
+            Value::Object object;
+            object["methods"] = std::move(methodsObject);
+            object["unknownMethodCalls"] = static_cast<int64_t>(unknownMethodCalls);
+            object["parseTime"] = parseTime.ToValue();
+            object["serialiseTime"] = serialiseTime.ToValue();
+            object["requestSize"] = requestSize.ToValue();
+            object["responseSize"] = responseSize.ToValue();
+            return Value(std::move(object));
+        }
+    };
+
+    // Measurements shared by a Dispatcher and its Server; the methods keep their own MethodMetrics
+    class Metrics {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        Metrics() { myUnknownMethodCalls.store(0, std::memory_order_relaxed); }
+
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        static uint64_t GetNanosecondsSince(Clock::time_point start) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        }
+
+        void RecordUnknownMethod() { myUnknownMethodCalls.fetch_add(1, std::memory_order_relaxed); }
+
+        Histogram& GetParseTime() { return myParseTime; }
+        Histogram& GetSerialiseTime() { return mySerialiseTime; }
+        Histogram& GetRequestSize() { return myRequestSize; }
+        Histogram& GetResponseSize() { return myResponseSize; }
+
+        // Fills everything but the methods
+        void GetReport(MetricsReport& report) const {
+            report.unknownMethodCalls = myUnknownMethodCalls.load(std::memory_order_relaxed);
+            report.parseTime = myParseTime.GetReport();
+            report.serialiseTime = mySerialiseTime.GetReport();
+            report.requestSize = myRequestSize.GetReport();
+            report.responseSize = myResponseSize.GetReport();
+        }
+
+    private:
+        std::atomic<uint64_t> myUnknownMethodCalls;
+        Histogram myParseTime;
+        Histogram mySerialiseTime;
+        Histogram myRequestSize;
+        Histogram myResponseSize;
+    };
+
+    // Records the time from its construction to Stop (or its destruction) into a histogram, if it is given one
+    class MetricsTimer {
+    public:
+        explicit MetricsTimer(Histogram* histogram) : myHistogram(histogram) {
+            if (myHistogram != nullptr) {
+                myStart = Metrics::Clock::now();
+            }
+        }
+
+        ~MetricsTimer() { Stop(); }
+
+        MetricsTimer(const MetricsTimer&) = delete;
+        MetricsTimer& operator=(const MetricsTimer&) = delete;
+
+        void Stop() {
+            if (myHistogram != nullptr) {
+                myHistogram->Record(Metrics::GetNanosecondsSince(myStart));
+                myHistogram = nullptr;
+            }
+        }
+
+    private:
+        Histogram* myHistogram;
+        Metrics::Clock::time_point myStart;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_METRICS_H
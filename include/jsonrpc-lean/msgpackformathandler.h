@@ -0,0 +1,73 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+#ifndef JSONRPC_LEAN_MSGPACKFORMATHANDLER_H
+#define JSONRPC_LEAN_MSGPACKFORMATHANDLER_H
+
+#include "formathandler.h"
+#include "msgpackreader.h"
+#include "msgpackwriter.h"
+
+#include <memory>
+
+namespace jsonrpc {
+
+    const char APPLICATION_MSGPACK[] = "application/msgpack";
+    // Still common, from before application/msgpack was registered
+    const char APPLICATION_X_MSGPACK[] = "application/x-msgpack";
+
+    class MsgPackFormatHandler : public FormatHandler {
+    public:
+        explicit MsgPackFormatHandler() {}
+
+        // FormatHandler
+        bool CanHandleRequest(const std::string& contentType) override {
+            return contentType == APPLICATION_MSGPACK || contentType == APPLICATION_X_MSGPACK;
+        }
+
+        std::string GetContentType() override {
+            return APPLICATION_MSGPACK;
+        }
+
+        bool UsesId() override {
+            return true;
+        }
+
+        using FormatHandler::CreateReader;
+
+        std::unique_ptr<Reader> CreateReader(const std::string& data) override {
+            return CreateReader(data.data(), data.size());
+        }
+
+        std::unique_ptr<Reader> CreateReader(const char* data, size_t size) override {
+            return std::unique_ptr<Reader>(std::make_unique<MsgPackReader>(data, size, GetReaderLimits()));
+        }
+
+        using FormatHandler::CreateWriter;
+
+        std::unique_ptr<Writer> CreateWriter() override {
+            return std::unique_ptr<Writer>(std::make_unique<MsgPackWriter>());
+        }
+
+        std::unique_ptr<Writer> CreateWriter(std::string buffer) override {
+            return std::unique_ptr<Writer>(std::make_unique<MsgPackWriter>(std::move(buffer)));
+        }
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_MSGPACKFORMATHANDLER_H
@@ -0,0 +1,218 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+#ifndef JSONRPC_LEAN_MSGPACKREADER_H
+#define JSONRPC_LEAN_MSGPACKREADER_H
+
+#include "fault.h"
+#include "json.h"
+#include "parselimits.h"
+#include "value.h"
+#include "valuereader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace jsonrpc {
+
+    // Reads MessagePack written by MsgPackWriter (or anything else with the same JSON-RPC 2.0 envelope).
+    // str and bin both become strings, nil becomes undefined as JSON null does, and integers that don't fit
+    // 32 bits become doubles, as in the other readers. Extension types are not supported.
+    class MsgPackReader final : public ValueReader {
+    public:
+        MsgPackReader(const std::string& data) : MsgPackReader(data.data(), data.size()) {
+        }
+
+        // Over parseLimits, an InvalidRequestFault is thrown; counts and sizes come before what they count
+        // in MessagePack, so nothing over them is read or allocated
+        MsgPackReader(const char* data, size_t size, const ParseLimits* parseLimits = nullptr)
+            : myCurrent(reinterpret_cast<const unsigned char*>(data)), myEnd(myCurrent + size) {
+            if (parseLimits != nullptr) {
+                myLimits = *parseLimits;
+                Check(size <= myLimits.maximumSize, limits::TOO_LARGE);
+            }
+            myDocument = ReadValue(0, false);
+            if (myCurrent != myEnd) {
+                throw ParseErrorFault("Parse error: data after the document");
+            }
+        }
+
+    private:
+        // Deeper documents are refused rather than risking the stack
+        static const size_t MAXIMUM_DEPTH = 512;
+
+        // isParams for the value of "params" in a request
+        Value ReadValue(size_t depth, bool isParams) {
+            const unsigned char type = Take();
+            if (type <= 0x7f) {
+                return Value(static_cast<int32_t>(type));
+            } else if (type <= 0x8f) {
+                return ReadObject(type & 0x0f, depth, isParams);
+            } else if (type <= 0x9f) {
+                return ReadArray(type & 0x0f, depth, isParams);
+            } else if (type <= 0xbf) {
+                return ReadString(type & 0x1f);
+            } else if (type >= 0xe0) {
+                return Value(static_cast<int32_t>(static_cast<int8_t>(type)));
+            }
+
+            switch (type) {
+            case 0xc0: return Value();
+            case 0xc2: return Value(false);
+            case 0xc3: return Value(true);
+            case 0xc4: return ReadString(ReadBigEndian(1), true);
+            case 0xc5: return ReadString(ReadBigEndian(2), true);
+            case 0xc6: return ReadString(ReadBigEndian(4), true);
+            case 0xd9: return ReadString(ReadBigEndian(1));
+            case 0xda: return ReadString(ReadBigEndian(2));
+            case 0xdb: return ReadString(ReadBigEndian(4));
+            case 0xca: {
+                const uint32_t bits = static_cast<uint32_t>(ReadBigEndian(4));
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                return Value(static_cast<double>(value));
+            }
+            case 0xcb: {
+                const uint64_t bits = ReadBigEndian(8);
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                return Value(value);
+            }
+            case 0xcc: return Value(static_cast<int32_t>(ReadBigEndian(1)));
+            case 0xcd: return Value(static_cast<int32_t>(ReadBigEndian(2)));
+            case 0xce: return Integer(static_cast<int64_t>(ReadBigEndian(4)));
+            case 0xcf: return Value(static_cast<double>(ReadBigEndian(8)));
+            case 0xd0: return Value(static_cast<int32_t>(static_cast<int8_t>(ReadBigEndian(1))));
+            case 0xd1: return Value(static_cast<int32_t>(static_cast<int16_t>(ReadBigEndian(2))));
+            case 0xd2: return Value(static_cast<int32_t>(ReadBigEndian(4)));
+            case 0xd3: return Integer(static_cast<int64_t>(ReadBigEndian(8)));
+            case 0xdc: return ReadArray(ReadBigEndian(2), depth, isParams);
+            case 0xdd: return ReadArray(ReadBigEndian(4), depth, isParams);
+            case 0xde: return ReadObject(ReadBigEndian(2), depth, isParams);
+            case 0xdf: return ReadObject(ReadBigEndian(4), depth, isParams);
+            default:
+                throw ParseErrorFault("Parse error: unsupported type " + std::to_string(type));
+            }
+        }
+
+        static Value Integer(int64_t value) {
+            if (value >= INT32_MIN && value <= INT32_MAX) {
+                return Value(static_cast<int32_t>(value));
+            }
+            return Value(value);
+        }
+
+        // binary for the bin types, so that they are written back as bin too
+        Value ReadString(uint64_t size, bool binary = false) {
+            Check(size <= myLimits.maximumStringLength, limits::STRING_TOO_LONG);
+            Need(size);
+            std::string string(reinterpret_cast<const char*>(myCurrent), static_cast<size_t>(size));
+            myCurrent += size;
+            return Value(std::move(string), binary);
+        }
+
+        Value ReadArray(uint64_t count, size_t depth, bool isParams) {
+            CheckContainer(count, depth, isParams);
+            if (depth == 0) {
+                myIsBatch = true;
+            }
+            // every element takes at least one byte, so count can't be trusted beyond that
+            Need(count);
+            Value::Array array;
+            array.reserve(static_cast<size_t>(count));
+            for (uint64_t i = 0; i < count; ++i) {
+                array.emplace_back(ReadValue(depth + 1, false));
+            }
+            return Value(std::move(array));
+        }
+
+        Value ReadObject(uint64_t count, size_t depth, bool isParams) {
+            CheckContainer(count, depth, isParams);
+            Need(count * 2);
+            Value::Object object;
+            object.reserve(static_cast<size_t>(count));
+            for (uint64_t i = 0; i < count; ++i) {
+                const unsigned char type = Take();
+                uint64_t size;
+                if (type >= 0xa0 && type <= 0xbf) {
+                    size = type & 0x1f;
+                } else if (type == 0xd9) {
+                    size = ReadBigEndian(1);
+                } else if (type == 0xda) {
+                    size = ReadBigEndian(2);
+                } else if (type == 0xdb) {
+                    size = ReadBigEndian(4);
+                } else {
+                    throw ParseErrorFault("Parse error: map key is not a string");
+                }
+                Check(size <= myLimits.maximumStringLength, limits::STRING_TOO_LONG);
+                Need(size);
+                std::string key(reinterpret_cast<const char*>(myCurrent), static_cast<size_t>(size));
+                myCurrent += size;
+                // of a request, at the top or in a batch
+                const bool isRequestParams = myLimits.maximumParameters != ParseLimits::UNLIMITED
+                    && depth == (myIsBatch ? 1 : 0) && key == json::PARAMS_NAME;
+                object[std::move(key)] = ReadValue(depth + 1, isRequestParams);
+            }
+            return Value(std::move(object));
+        }
+
+        void CheckContainer(uint64_t count, size_t depth, bool isParams) const {
+            if (depth >= MAXIMUM_DEPTH) {
+                throw ParseErrorFault("Parse error: document nested too deeply");
+            }
+            Check(depth < myLimits.maximumDepth, limits::TOO_DEEP);
+            Check(!isParams || count <= myLimits.maximumParameters, limits::TOO_MANY_PARAMETERS);
+            Check(count <= myLimits.maximumArraySize, limits::TOO_MANY_ELEMENTS);
+        }
+
+        static void Check(bool withinLimit, const char* fault) {
+            if (!withinLimit) {
+                throw InvalidRequestFault(fault);
+            }
+        }
+
+        void Need(uint64_t size) const {
+            if (size > static_cast<uint64_t>(myEnd - myCurrent)) {
+                throw ParseErrorFault("Parse error: unexpected end of data");
+            }
+        }
+
+        unsigned char Take() {
+            Need(1);
+            return *myCurrent++;
+        }
+
+        uint64_t ReadBigEndian(size_t size) {
+            Need(size);
+            uint64_t value = 0;
+            for (size_t i = 0; i < size; ++i) {
+                value = (value << 8) | *myCurrent++;
+            }
+            return value;
+        }
+
+        const unsigned char* myCurrent;
+        const unsigned char* myEnd;
+        ParseLimits myLimits;
+        bool myIsBatch = false;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_MSGPACKREADER_H
@@ -0,0 +1,422 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+#ifndef JSONRPC_LEAN_MSGPACKWRITER_H
+#define JSONRPC_LEAN_MSGPACKWRITER_H
+
+#include "writer.h"
+#include "json.h"
+#include "util.h"
+#include "value.h"
+#include "msgpackformatteddata.h"
+#include "fault.h"
+
+#define RAPIDJSON_NO_SIZETYPEDEFINE
+namespace rapidjson { typedef ::std::size_t SizeType; }
+
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace jsonrpc {
+
+    // Writes MessagePack (https://msgpack.org), with the same JSON-RPC 2.0 envelope as JsonWriter. Numbers are
+    // written in their smallest encoding, binary data as bin. The number of elements of an array or struct is only
+    // known at its end, so room for the largest header is left at the start and the content moved back over it
+    // once the actual (usually one byte) header is known.
+    class MsgPackWriter final : public Writer {
+    public:
+        MsgPackWriter() : myRequestData(std::make_shared<MsgPackFormattedData>()) {
+        }
+
+        // Writes into buffer, reusing its capacity; get it back with GetData()->ReleaseBuffer()
+        explicit MsgPackWriter(std::string buffer) : myRequestData(std::make_shared<MsgPackFormattedData>(std::move(buffer))) {
+        }
+
+        // Writer
+        std::shared_ptr<FormattedData> GetData() override {
+            return std::static_pointer_cast<FormattedData>(myRequestData);
+        }
+
+        void StartDocument() override {
+            // Empty
+        }
+
+        void EndDocument() override {
+            // Empty
+        }
+
+        void StartBatch() override {
+            StartContainer(Frame::ARRAY);
+        }
+
+        void EndBatch() override {
+            EndContainer();
+        }
+
+        void StartRequest(const std::string& methodName, const Value& id) override {
+            StartEnvelope(HasId(id) ? 4 : 3);
+            WriteKey(json::METHOD_NAME);
+            WriteString(methodName.data(), methodName.size());
+            WriteId(id);
+            WriteKey(json::PARAMS_NAME);
+            StartContainer(Frame::ARRAY);
+        }
+
+        void EndRequest() override {
+            EndContainer();
+            EndContainer();
+        }
+
+        void StartParameter() override {
+            // Empty
+        }
+
+        void EndParameter() override {
+            // Empty
+        }
+
+        void StartResponse(const Value& id) override {
+            StartEnvelope(HasId(id) ? 3 : 2);
+            WriteId(id);
+            WriteKey(json::RESULT_NAME);
+        }
+
+        void EndResponse() override {
+            EndContainer();
+        }
+
+        void StartFaultResponse(const Value& id) override {
+            StartEnvelope(HasId(id) ? 3 : 2);
+            WriteId(id);
+        }
+
+        void EndFaultResponse() override {
+            EndContainer();
+        }
+
+        void WriteFault(int32_t code, const std::string& string) override {
+            WriteKey(json::ERROR_NAME);
+            WriteHeader(0x80, 0xde, 2);
+            WriteKey(json::ERROR_CODE_NAME);
+            WriteInteger(code);
+            WriteKey(json::ERROR_MESSAGE_NAME);
+            WriteString(string.data(), string.size());
+        }
+
+        void StartArray() override {
+            StartContainer(Frame::ARRAY);
+        }
+
+        void EndArray() override {
+            EndContainer();
+        }
+
+        void StartStruct() override {
+            StartContainer(Frame::STRUCT);
+        }
+
+        void EndStruct() override {
+            EndContainer();
+        }
+
+        void StartStructElement(const std::string& name) override {
+            ++myFrames.back().count;
+            WriteString(name.data(), name.size());
+        }
+
+        void EndStructElement() override {
+            // Empty
+        }
+
+        void WriteBinary(const char* data, size_t size) override {
+            AddElement();
+            if (size <= 0xff) {
+                Put(0xc4);
+                PutBigEndian(size, 1);
+            } else if (size <= 0xffff) {
+                Put(0xc5);
+                PutBigEndian(size, 2);
+            } else {
+                Put(0xc6);
+                PutBigEndian(size, 4);
+            }
+            GetBuffer().append(data, size);
+        }
+
+        void WriteNull() override {
+            AddElement();
+            Put(0xc0);
+        }
+
+        void Write(bool value) override {
+            AddElement();
+            Put(value ? 0xc3 : 0xc2);
+        }
+
+        void Write(double value) override {
+            AddElement();
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            Put(0xcb);
+            PutBigEndian(bits, 8);
+        }
+
+        void Write(int32_t value) override {
+            AddElement();
+            WriteInteger(value);
+        }
+
+        void Write(int64_t value) override {
+            AddElement();
+            WriteInteger(value);
+        }
+
+        void Write(const std::string& value) override {
+            AddElement();
+            WriteString(value.data(), value.size());
+        }
+
+        void Write(const tm& value) override {
+            char str[util::MAXIMUM_DATE_TIME_SIZE];
+            const size_t size = util::FormatIso8601DateTime(value, str);
+            AddElement();
+            WriteString(str, size);
+        }
+
+        void WriteRaw(const char* data, size_t size) override {
+            AddElement();
+            GetBuffer().append(data, size);
+        }
+
+        // MessagePack can't carry JSON text as it is, the text is parsed and written as the value it holds
+        void WriteRawJson(const char* data, size_t size) override {
+            rapidjson::MemoryStream stream(data, size);
+            RawJsonHandler handler{ *this };
+            rapidjson::Reader reader;
+            if (reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler).IsError()) {
+                throw InternalErrorFault("invalid raw JSON value");
+            }
+        }
+
+    private:
+        // Replays rapidjson's parsing events as writes
+        struct RawJsonHandler {
+            MsgPackWriter& writer;
+
+            bool Null() { writer.WriteNull(); return true; }
+            bool Bool(bool value) { writer.Write(value); return true; }
+            bool Int(int value) { writer.Write(static_cast<int32_t>(value)); return true; }
+            bool Uint(unsigned value) { writer.Write(static_cast<int64_t>(value)); return true; }
+            bool Int64(int64_t value) { writer.Write(value); return true; }
+            bool Uint64(uint64_t value) {
+                if (value > static_cast<uint64_t>(INT64_MAX)) {
+                    writer.Write(static_cast<double>(value));
+                } else {
+                    writer.Write(static_cast<int64_t>(value));
+                }
+                return true;
+            }
+            bool Double(double value) { writer.Write(value); return true; }
+            bool RawNumber(const char*, rapidjson::SizeType, bool) { return false; }
+            bool String(const char* value, rapidjson::SizeType size, bool) {
+                writer.AddElement();
+                writer.WriteString(value, size);
+                return true;
+            }
+            bool StartObject() { writer.StartStruct(); return true; }
+            bool Key(const char* name, rapidjson::SizeType size, bool) {
+                ++writer.myFrames.back().count;
+                writer.WriteString(name, size);
+                return true;
+            }
+            bool EndObject(rapidjson::SizeType) { writer.EndStruct(); return true; }
+            bool StartArray() { writer.StartArray(); return true; }
+            bool EndArray(rapidjson::SizeType) { writer.EndArray(); return true; }
+        };
+
+        struct Frame {
+            enum Kind {
+                ARRAY,
+                STRUCT,
+                // envelope written with its final header, elements are not counted
+                FIXED,
+            };
+
+            size_t offset;
+            size_t count;
+            Kind kind;
+        };
+
+        // Largest array/map header: 1 type byte and a 32 bit count
+        static const size_t MAXIMUM_HEADER_SIZE = 5;
+
+        std::string& GetBuffer() { return myRequestData->GetBuffer(); }
+
+        void Put(unsigned char byte) { GetBuffer().push_back(static_cast<char>(byte)); }
+
+        void PutBigEndian(uint64_t value, size_t size) {
+            for (size_t i = size; i-- > 0;) {
+                Put(static_cast<unsigned char>(value >> (i * 8)));
+            }
+        }
+
+        // Every value counts as one element of the array it is written into
+        void AddElement() {
+            if (!myFrames.empty() && myFrames.back().kind == Frame::ARRAY) {
+                ++myFrames.back().count;
+            }
+        }
+
+        void StartContainer(Frame::Kind kind) {
+            AddElement();
+            myFrames.push_back({ GetBuffer().size(), 0, kind });
+            GetBuffer().append(MAXIMUM_HEADER_SIZE, '\0');
+        }
+
+        void StartEnvelope(size_t count) {
+            AddElement();
+            myFrames.push_back({ GetBuffer().size(), count, Frame::FIXED });
+            WriteHeader(0x80, 0xde, count);
+            WriteKey(json::JSONRPC_NAME);
+            WriteString(json::JSONRPC_VERSION_2_0, sizeof(json::JSONRPC_VERSION_2_0) - 1);
+        }
+
+        void EndContainer() {
+            const Frame frame = myFrames.back();
+            myFrames.pop_back();
+            if (frame.kind == Frame::FIXED) {
+                return;
+            }
+
+            // write the header at the end, then move it in front of the content
+            std::string& buffer = GetBuffer();
+            const size_t end = buffer.size();
+            if (frame.kind == Frame::ARRAY) {
+                WriteHeader(0x90, 0xdc, frame.count);
+            } else {
+                WriteHeader(0x80, 0xde, frame.count);
+            }
+            const size_t headerSize = buffer.size() - end;
+            char header[MAXIMUM_HEADER_SIZE];
+            memcpy(header, buffer.data() + end, headerSize);
+
+            const size_t content = frame.offset + MAXIMUM_HEADER_SIZE;
+            memmove(&buffer[frame.offset + headerSize], buffer.data() + content, end - content);
+            memcpy(&buffer[frame.offset], header, headerSize);
+            buffer.resize(end - (MAXIMUM_HEADER_SIZE - headerSize));
+        }
+
+        // fix is the type byte holding counts up to 15, fix16 the one followed by a 16 bit count (+1 for 32 bit)
+        void WriteHeader(unsigned char fix, unsigned char fix16, size_t count) {
+            if (count <= 15) {
+                Put(static_cast<unsigned char>(fix | count));
+            } else if (count <= 0xffff) {
+                Put(fix16);
+                PutBigEndian(count, 2);
+            } else {
+                Put(fix16 + 1);
+                PutBigEndian(count, 4);
+            }
+        }
+
+        void WriteKey(const char* name) {
+            WriteString(name, strlen(name));
+        }
+
+        void WriteString(const char* data, size_t size) {
+            if (size <= 31) {
+                Put(static_cast<unsigned char>(0xa0 | size));
+            } else if (size <= 0xff) {
+                Put(0xd9);
+                PutBigEndian(size, 1);
+            } else if (size <= 0xffff) {
+                Put(0xda);
+                PutBigEndian(size, 2);
+            } else {
+                Put(0xdb);
+                PutBigEndian(size, 4);
+            }
+            GetBuffer().append(data, size);
+        }
+
+        void WriteInteger(int64_t value) {
+            if (value >= 0) {
+                if (value <= 0x7f) {
+                    Put(static_cast<unsigned char>(value));
+                } else if (value <= 0xff) {
+                    Put(0xcc);
+                    PutBigEndian(static_cast<uint64_t>(value), 1);
+                } else if (value <= 0xffff) {
+                    Put(0xcd);
+                    PutBigEndian(static_cast<uint64_t>(value), 2);
+                } else if (value <= 0xffffffffLL) {
+                    Put(0xce);
+                    PutBigEndian(static_cast<uint64_t>(value), 4);
+                } else {
+                    Put(0xcf);
+                    PutBigEndian(static_cast<uint64_t>(value), 8);
+                }
+            } else if (value >= -32) {
+                Put(static_cast<unsigned char>(value));
+            } else if (value >= INT8_MIN) {
+                Put(0xd0);
+                PutBigEndian(static_cast<uint64_t>(value), 1);
+            } else if (value >= INT16_MIN) {
+                Put(0xd1);
+                PutBigEndian(static_cast<uint64_t>(value), 2);
+            } else if (value >= INT32_MIN) {
+                Put(0xd2);
+                PutBigEndian(static_cast<uint64_t>(value), 4);
+            } else {
+                Put(0xd3);
+                PutBigEndian(static_cast<uint64_t>(value), 8);
+            }
+        }
+
+        static bool HasId(const Value& id) {
+            return id.IsString() || id.IsInteger32() || id.IsInteger64() || id.IsNil();
+        }
+
+        // Same ids as JsonWriter writes: a notification (false) or undefined id is left out
+        void WriteId(const Value& id) {
+            if (!HasId(id)) {
+                return;
+            }
+            WriteKey(json::ID_NAME);
+            if (id.IsString()) {
+                WriteString(id.AsString().data(), id.AsString().size());
+            } else if (id.IsInteger32()) {
+                WriteInteger(id.AsInteger32());
+            } else if (id.IsInteger64()) {
+                WriteInteger(id.AsInteger64());
+            } else {
+                Put(0xc0);
+            }
+        }
+
+        std::shared_ptr<MsgPackFormattedData> myRequestData;
+        std::vector<Frame> myFrames;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_MSGPACKWRITER_H
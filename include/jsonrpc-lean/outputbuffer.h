@@ -0,0 +1,147 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_OUTPUTBUFFER_H
+#define JSONRPC_LEAN_OUTPUTBUFFER_H
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jsonrpc {
+
+    class OutputBufferPool;
+
+    // Move-only handle to formatted output. The capacity of the buffer is kept from one use to the next:
+    // reuse the same OutputBuffer, or get one from an OutputBufferPool to which it goes back when destroyed.
+    class OutputBuffer {
+    public:
+        OutputBuffer() {}
+
+        OutputBuffer(OutputBuffer&& other) noexcept : myBuffer(std::move(other.myBuffer)), myPool(other.myPool) {
+            other.myPool = nullptr;
+        }
+
+        OutputBuffer& operator=(OutputBuffer&& other) noexcept {
+            if (this != &other) {
+                GiveBack();
+                myBuffer = std::move(other.myBuffer);
+                myPool = other.myPool;
+                other.myPool = nullptr;
+            }
+            return *this;
+        }
+
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        inline ~OutputBuffer();
+
+        const char* GetData() const { return myBuffer.c_str(); }
+        size_t GetSize() const { return myBuffer.size(); }
+        bool IsEmpty() const { return myBuffer.empty(); }
+
+        // Used by the writers: the buffer is taken out (cleared, capacity intact) and put back once written
+        std::string Take() {
+            std::string buffer(std::move(myBuffer));
+            buffer.clear();
+            myBuffer = std::string();
+            return buffer;
+        }
+
+        void Put(std::string buffer) { myBuffer = std::move(buffer); }
+
+    private:
+        inline void GiveBack();
+
+        std::string myBuffer;
+        OutputBufferPool* myPool = nullptr;
+
+        friend class OutputBufferPool;
+    };
+
+    // Thread safe pool of output buffers. New buffers are reserved at the typical size of recent output, and
+    // buffers that grew far beyond it are let go instead of being kept, so one huge response doesn't stay pinned.
+    class OutputBufferPool {
+    public:
+        explicit OutputBufferPool(size_t maximumBuffers = 64, size_t initialSize = 1024)
+            : myMaximumBuffers(maximumBuffers), myTypicalSize(initialSize) {
+        }
+
+        OutputBufferPool(const OutputBufferPool&) = delete;
+        OutputBufferPool& operator=(const OutputBufferPool&) = delete;
+
+        // All buffers acquired from the pool must be destroyed before it is
+        OutputBuffer Acquire() {
+            OutputBuffer output;
+            output.myPool = this;
+
+            std::unique_lock<std::mutex> lock(myMutex);
+            const size_t typicalSize = myTypicalSize;
+            if (!myBuffers.empty()) {
+                output.myBuffer = std::move(myBuffers.back());
+                myBuffers.pop_back();
+            }
+            lock.unlock();
+
+            output.myBuffer.reserve(typicalSize);
+            return output;
+        }
+
+        size_t GetTypicalSize() const {
+            std::lock_guard<std::mutex> lock(myMutex);
+            return myTypicalSize;
+        }
+
+    private:
+        void Release(std::string buffer) {
+            std::lock_guard<std::mutex> lock(myMutex);
+
+            // moving average over the last few dozen outputs, with some headroom so most fit at once
+            const size_t size = buffer.size() + buffer.size() / 4;
+            myTypicalSize = myTypicalSize - myTypicalSize / 16 + size / 16;
+
+            if (myBuffers.size() < myMaximumBuffers && buffer.capacity() <= 4 * myTypicalSize) {
+                buffer.clear();
+                myBuffers.emplace_back(std::move(buffer));
+            }
+        }
+
+        mutable std::mutex myMutex;
+        std::vector<std::string> myBuffers;
+        size_t myMaximumBuffers;
+        size_t myTypicalSize;
+
+        friend class OutputBuffer;
+    };
+
+    inline OutputBuffer::~OutputBuffer() {
+        GiveBack();
+    }
+
+    inline void OutputBuffer::GiveBack() {
+        if (myPool != nullptr) {
+            myPool->Release(std::move(myBuffer));
+            myPool = nullptr;
+        }
+    }
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_OUTPUTBUFFER_H
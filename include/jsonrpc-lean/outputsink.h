@@ -0,0 +1,128 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_OUTPUTSINK_H
+#define JSONRPC_LEAN_OUTPUTSINK_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jsonrpc {
+
+    // Where a writer created by FormatHandler::CreateWriter(OutputSink&) sends its output while it is still
+    // writing: in chunks of about GetChunkSize() bytes, and what is left once done, so that no more than a
+    // chunk of it is held at once and sending one chunk can overlap writing the next
+    class OutputSink {
+    public:
+        static const size_t DEFAULT_CHUNK_SIZE = 16384;
+
+        explicit OutputSink(size_t chunkSize = DEFAULT_CHUNK_SIZE) : myChunkSize(chunkSize > 0 ? chunkSize : 1) {}
+        virtual ~OutputSink() {}
+
+        size_t GetChunkSize() const { return myChunkSize; }
+
+        // Bytes handed to the sink so far
+        size_t GetSize() const { return mySize; }
+
+        // Used by the writers
+        void Append(const char* data, size_t size) {
+            mySize += size;
+            Write(data, size);
+        }
+
+    protected:
+        // data is only valid during the call
+        virtual void Write(const char* data, size_t size) = 0;
+
+        void ResetSize() { mySize = 0; }
+
+    private:
+        size_t myChunkSize;
+        size_t mySize = 0;
+    };
+
+    // Hands each chunk to a function, e.g. one sending it on a socket
+    class CallbackOutputSink final : public OutputSink {
+    public:
+        typedef std::function<void(const char* data, size_t size)> Callback;
+
+        explicit CallbackOutputSink(Callback callback, size_t chunkSize = DEFAULT_CHUNK_SIZE)
+            : OutputSink(chunkSize), myCallback(std::move(callback)) {
+        }
+
+    protected:
+        void Write(const char* data, size_t size) override {
+            myCallback(data, size);
+        }
+
+    private:
+        Callback myCallback;
+    };
+
+    // Keeps the chunks apart instead of in one contiguous buffer, to send them all with one writev or sendmsg
+    // (see GetIovecs). Cleared, it keeps the chunks it has for the next response.
+    class ChunkedOutputSink final : public OutputSink {
+    public:
+        explicit ChunkedOutputSink(size_t chunkSize = DEFAULT_CHUNK_SIZE) : OutputSink(chunkSize) {}
+
+        size_t GetChunkCount() const { return myChunkCount; }
+        const std::string& GetChunk(size_t index) const { return myChunks[index]; }
+
+        // Fills vectors with the chunks; IovecType is struct iovec, or anything else with iov_base and iov_len
+        template<typename IovecType>
+        void GetIovecs(std::vector<IovecType>& vectors) const {
+            vectors.resize(myChunkCount);
+            for (size_t i = 0; i < myChunkCount; ++i) {
+                vectors[i].iov_base = const_cast<char*>(myChunks[i].data());
+                vectors[i].iov_len = myChunks[i].size();
+            }
+        }
+
+        // The chunks one after the other
+        std::string ToString() const {
+            std::string string;
+            for (size_t i = 0; i < myChunkCount; ++i) {
+                string += myChunks[i];
+            }
+            return string;
+        }
+
+        void Clear() {
+            myChunkCount = 0;
+            ResetSize();
+        }
+
+    protected:
+        void Write(const char* data, size_t size) override {
+            if (myChunkCount == myChunks.size()) {
+                myChunks.emplace_back();
+            }
+            myChunks[myChunkCount++].assign(data, size);
+        }
+
+    private:
+        std::vector<std::string> myChunks;
+        size_t myChunkCount = 0;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_OUTPUTSINK_H
@@ -0,0 +1,104 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_PARAMETERNAMES_H
+#define JSONRPC_LEAN_PARAMETERNAMES_H
+
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace jsonrpc {
+
+    // Names of the parameters of a method, in order, with a perfect hash table from name to position built
+    // once when the method is registered: a seed is searched for that gives every name a slot of its own, so a
+    // lookup is one hash and one comparison.
+    class ParameterNames {
+    public:
+        static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+        explicit ParameterNames(std::vector<std::string> names) : myNames(std::move(names)) {
+            for (size_t i = 0; i < myNames.size(); ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    if (myNames[i] == myNames[j]) {
+                        throw std::invalid_argument("duplicated parameter name: " + myNames[i]);
+                    }
+                }
+            }
+
+            size_t capacity = 1;
+            while (capacity < 2 * myNames.size()) {
+                capacity *= 2;
+            }
+            // a few dozen seeds are plenty at this load; a bigger table makes collisions rarer still
+            while (!Build(capacity)) {
+                capacity *= 2;
+            }
+        }
+
+        size_t Size() const { return myNames.size(); }
+        const std::string& operator[](size_t index) const { return myNames[index]; }
+
+        // Position of the parameter called name, or NOT_FOUND
+        size_t Find(const char* name, size_t nameSize) const {
+            const uint32_t slot = mySlots[Hash(name, nameSize, mySeed) & (mySlots.size() - 1)];
+            if (slot == 0) {
+                return NOT_FOUND;
+            }
+            const std::string& candidate = myNames[slot - 1];
+            return candidate.size() == nameSize && memcmp(candidate.data(), name, nameSize) == 0 ? slot - 1 : NOT_FOUND;
+        }
+
+    private:
+        bool Build(size_t capacity) {
+            for (uint64_t seed = 0; seed < 64; ++seed) {
+                mySlots.assign(capacity, 0);
+                bool collision = false;
+                for (size_t i = 0; i < myNames.size() && !collision; ++i) {
+                    uint32_t& slot = mySlots[Hash(myNames[i].data(), myNames[i].size(), seed) & (capacity - 1)];
+                    collision = slot != 0;
+                    slot = static_cast<uint32_t>(i + 1);
+                }
+                if (!collision) {
+                    mySeed = seed;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // FNV-1a, with the seed mixed into the offset basis
+        static uint64_t Hash(const char* name, size_t nameSize, uint64_t seed) {
+            uint64_t hash = 14695981039346656037ull ^ (seed * 0x9e3779b97f4a7c15ull);
+            for (size_t i = 0; i < nameSize; ++i) {
+                hash = (hash ^ static_cast<unsigned char>(name[i])) * 1099511628211ull;
+            }
+            return hash ^ (hash >> 32);
+        }
+
+        std::vector<std::string> myNames;
+        // index + 1 of the name in each slot, 0 if none
+        std::vector<uint32_t> mySlots;
+        uint64_t mySeed = 0;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_PARAMETERNAMES_H
@@ -0,0 +1,207 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_PARSELIMITS_H
+#define JSONRPC_LEAN_PARSELIMITS_H
+
+#include "fault.h"
+#include "json.h"
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace jsonrpc {
+
+    // What the readers of a FormatHandler accept (see FormatHandler::SetParseLimits, Server::SetParseLimits).
+    // They are checked while parsing, so a request over one of them is refused with an InvalidRequestFault
+    // once it has been read that far, before the rest of it costs anything.
+    struct ParseLimits {
+        static const size_t UNLIMITED = static_cast<size_t>(-1);
+
+        // Of the whole request
+        size_t maximumSize = UNLIMITED;
+        // Arrays and objects inside each other; a request is 1 deep, its parameters 2, and a batch adds 1
+        size_t maximumDepth = UNLIMITED;
+        // Elements or members of the parameters of a request
+        size_t maximumParameters = UNLIMITED;
+        // Elements of any array (a batch too) or members of any object
+        size_t maximumArraySize = UNLIMITED;
+        // Of any string or member name, in bytes
+        size_t maximumStringLength = UNLIMITED;
+
+        bool IsUnlimited() const {
+            return maximumSize == UNLIMITED && maximumDepth == UNLIMITED && maximumParameters == UNLIMITED
+                && maximumArraySize == UNLIMITED && maximumStringLength == UNLIMITED;
+        }
+    };
+
+    // Messages of the InvalidRequestFaults over each limit
+    namespace limits {
+        const char TOO_LARGE[] = "Invalid request: too large";
+        const char TOO_DEEP[] = "Invalid request: nested too deeply";
+        const char TOO_MANY_PARAMETERS[] = "Invalid request: too many parameters";
+        const char TOO_MANY_ELEMENTS[] = "Invalid request: array or object too large";
+        const char STRING_TOO_LONG[] = "Invalid request: string too long";
+    } // namespace limits
+
+    // Follows a document value by value as a reader parses it and tells when it goes over the limits.
+    // Each call returns false once a limit is exceeded, GetFault() then says which.
+    class ParseLimitChecker {
+    public:
+        explicit ParseLimitChecker(const ParseLimits& limits) : myLimits(limits) {}
+
+        bool Size(size_t size) {
+            return Check(size <= myLimits.maximumSize, limits::TOO_LARGE);
+        }
+
+        bool Scalar() {
+            myIsParamsNext = false;
+            return CountElement();
+        }
+
+        bool String(size_t length) {
+            myIsParamsNext = false;
+            return CheckString(length) && CountElement();
+        }
+
+        bool Key(const char* name, size_t length) {
+            if (!CheckString(length)) {
+                return false;
+            }
+            Level& level = myLevels.back();
+            ++level.count;
+            // the value of "params" in a request, at the top or in a batch
+            myIsParamsNext = myLevels.size() == (myIsBatch ? 2 : 1) && length == sizeof(json::PARAMS_NAME) - 1
+                && memcmp(name, json::PARAMS_NAME, length) == 0;
+            return CheckCount(level);
+        }
+
+        bool StartContainer(bool isObject) {
+            if (!CountElement() || !Check(myLevels.size() < myLimits.maximumDepth, limits::TOO_DEEP)) {
+                return false;
+            }
+            if (myLevels.empty()) {
+                myIsBatch = !isObject;
+            }
+            myLevels.push_back({ 0, isObject, myIsParamsNext });
+            myIsParamsNext = false;
+            return true;
+        }
+
+        bool EndContainer() {
+            myLevels.pop_back();
+            return true;
+        }
+
+        bool IsExceeded() const { return myFault != nullptr; }
+
+        InvalidRequestFault GetFault() const {
+            return myFault != nullptr ? InvalidRequestFault(myFault) : InvalidRequestFault();
+        }
+
+    private:
+        struct Level {
+            size_t count;
+            bool isObject;
+            bool isParams;
+        };
+
+        bool Check(bool withinLimit, const char* fault) {
+            if (!withinLimit) {
+                myFault = fault;
+            }
+            return withinLimit;
+        }
+
+        bool CheckString(size_t length) {
+            return Check(length <= myLimits.maximumStringLength, limits::STRING_TOO_LONG);
+        }
+
+        bool CheckCount(const Level& level) {
+            if (level.isParams && !Check(level.count <= myLimits.maximumParameters, limits::TOO_MANY_PARAMETERS)) {
+                return false;
+            }
+            return Check(level.count <= myLimits.maximumArraySize, limits::TOO_MANY_ELEMENTS);
+        }
+
+        // members of objects are counted by their names
+        bool CountElement() {
+            if (myLevels.empty() || myLevels.back().isObject) {
+                return true;
+            }
+            Level& level = myLevels.back();
+            ++level.count;
+            return CheckCount(level);
+        }
+
+        const ParseLimits& myLimits;
+        std::vector<Level> myLevels;
+        const char* myFault = nullptr;
+        bool myIsBatch = false;
+        bool myIsParamsNext = false;
+    };
+
+    // rapidjson SAX handler passing each event on to handler (a rapidjson::Document, or another handler) once
+    // checker has taken it, and stopping the parse at the first one over the limits
+    template<typename HandlerType>
+    class LimitedHandler {
+    public:
+        LimitedHandler(HandlerType& handler, ParseLimitChecker& checker) : myHandler(handler), myChecker(checker) {}
+
+        bool Null() { return myChecker.Scalar() && myHandler.Null(); }
+        bool Bool(bool value) { return myChecker.Scalar() && myHandler.Bool(value); }
+        bool Int(int value) { return myChecker.Scalar() && myHandler.Int(value); }
+        bool Uint(unsigned value) { return myChecker.Scalar() && myHandler.Uint(value); }
+        bool Int64(int64_t value) { return myChecker.Scalar() && myHandler.Int64(value); }
+        bool Uint64(uint64_t value) { return myChecker.Scalar() && myHandler.Uint64(value); }
+        bool Double(double value) { return myChecker.Scalar() && myHandler.Double(value); }
+
+        template<typename SizeType>
+        bool RawNumber(const char* value, SizeType length, bool copy) {
+            return myChecker.Scalar() && myHandler.RawNumber(value, length, copy);
+        }
+
+        template<typename SizeType>
+        bool String(const char* value, SizeType length, bool copy) {
+            return myChecker.String(length) && myHandler.String(value, length, copy);
+        }
+
+        bool StartObject() { return myChecker.StartContainer(true) && myHandler.StartObject(); }
+
+        template<typename SizeType>
+        bool Key(const char* name, SizeType length, bool copy) {
+            return myChecker.Key(name, length) && myHandler.Key(name, length, copy);
+        }
+
+        template<typename SizeType>
+        bool EndObject(SizeType memberCount) { return myChecker.EndContainer() && myHandler.EndObject(memberCount); }
+
+        bool StartArray() { return myChecker.StartContainer(false) && myHandler.StartArray(); }
+
+        template<typename SizeType>
+        bool EndArray(SizeType elementCount) { return myChecker.EndContainer() && myHandler.EndArray(elementCount); }
+
+    private:
+        HandlerType& myHandler;
+        ParseLimitChecker& myChecker;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_PARSELIMITS_H
@@ -0,0 +1,296 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_PIPELINEDCLIENT_H
+#define JSONRPC_LEAN_PIPELINEDCLIENT_H
+
+#include "compat.h"
+#include "fault.h"
+#include "formathandler.h"
+#include "formatteddata.h"
+#include "jsonwriter.h"
+#include "reader.h"
+#include "request.h"
+#include "response.h"
+#include "value.h"
+#include "writer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef JSONRPC_LEAN_HAS_COROUTINES
+#include <coroutine>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#endif
+
+namespace jsonrpc {
+
+    // Client for many calls in flight over one connection, answered in any order. Each request gets an id
+    // from an atomic counter and a pending entry that the response carrying that id resolves. Thread safe:
+    // any number of threads may build requests and feed responses at the same time. Sending and receiving
+    // the data is left to the caller, as with Client.
+    class PipelinedClient {
+    public:
+        // Receives the response, or a fault response if the call timed out or was cancelled; check it with
+        // Response::IsFault or ThrowIfFault. Called without any lock held, from the thread that resolved the call.
+        typedef std::function<void(Response response)> ResponseCallback;
+        typedef std::chrono::steady_clock Clock;
+
+        // Fault codes of calls completed by the client itself, outside the range reserved by JSON-RPC
+        enum LocalFaultCodes : int32_t {
+            TIMED_OUT = -31000,
+            CANCELLED = -31001,
+        };
+
+        struct Call {
+            int32_t id;
+            std::shared_ptr<FormattedData> data;
+        };
+
+        struct FutureCall {
+            int32_t id;
+            std::shared_ptr<FormattedData> data;
+            // Gets the result, or the fault thrown as by Client::ParseResponse
+            std::future<Value> result;
+        };
+
+        // Sends the data of a request, for the calls that do it themselves (AsyncCall)
+        typedef std::function<void(const std::shared_ptr<FormattedData>& data)> SendFunction;
+
+        explicit PipelinedClient(FormatHandler& formatHandler) : myFormatHandler(formatHandler), myId(0) {}
+
+        // Calls still pending are dropped without their callbacks being called
+        ~PipelinedClient() {}
+
+        PipelinedClient(const PipelinedClient&) = delete;
+        PipelinedClient& operator=(const PipelinedClient&) = delete;
+
+        // A zero timeout waits forever; otherwise the call fails with TIMED_OUT at the first ExpireTimedOut after it
+        Call BuildRequestData(const std::string& methodName, const Request::Parameters& params, ResponseCallback onResponse,
+            Clock::duration timeout = Clock::duration::zero()) {
+            const int32_t id = myId++;
+            auto writer = myFormatHandler.CreateWriter();
+            const Value idValue(id);
+            WriteStatic(*writer, [&](auto& w) { Request::Write(methodName, params, idValue, w); });
+
+            // registered before the data is handed out, so the response can't arrive first
+            Pending pending;
+            pending.onResponse = std::move(onResponse);
+            pending.deadline = timeout == Clock::duration::zero() ? Clock::time_point::max() : Clock::now() + timeout;
+            {
+                std::lock_guard<std::mutex> lock(myMutex);
+                myPending.emplace(id, std::move(pending));
+            }
+            return{ id, writer->GetData() };
+        }
+
+        FutureCall BuildRequestData(const std::string& methodName, const Request::Parameters& params = {},
+            Clock::duration timeout = Clock::duration::zero()) {
+            auto promise = std::make_shared<std::promise<Value>>();
+            auto result = promise->get_future();
+            Call call = BuildRequestData(methodName, params, [promise](Response response) {
+                try {
+                    response.ThrowIfFault();
+                    promise->set_value(std::move(response.GetResult()));
+                } catch (...) {
+                    promise->set_exception(std::current_exception());
+                }
+            }, timeout);
+            return{ call.id, std::move(call.data), std::move(result) };
+        }
+
+        // Set before AsyncCall is used, e.g. to one writing the data to the connection; may be called from any thread
+        void SetSendFunction(SendFunction send) {
+            mySend = std::move(send);
+        }
+
+#ifdef JSONRPC_LEAN_HAS_COROUTINES
+        class CallAwaiter;
+
+        // co_await client.AsyncCall("add", 1, 2) gets the result or throws the fault, as Client::ParseResponse does.
+        // The request is built and sent through the send function once the coroutine has suspended, and the
+        // coroutine is resumed by HandleResponse (or Cancel, ExpireTimedOut) on whichever thread resolves the call.
+        CallAwaiter AsyncCall(const std::string& methodName, Request::Parameters params = {}, Clock::duration timeout = Clock::duration::zero()) {
+            return CallAwaiter(*this, methodName, std::move(params), timeout);
+        }
+
+        template<typename FirstType, typename... RestTypes>
+        typename std::enable_if<!std::is_same<typename std::decay<FirstType>::type, Request::Parameters>::value, CallAwaiter>::type
+        AsyncCall(const std::string& methodName, FirstType&& first, RestTypes&&... rest) {
+            Request::Parameters params;
+            params.emplace_back(std::forward<FirstType>(first));
+            (params.emplace_back(std::forward<RestTypes>(rest)), ...);
+            return AsyncCall(methodName, std::move(params));
+        }
+
+        // Lives in the awaiting coroutine's frame; the call's pending entry points to it
+        class CallAwaiter {
+        public:
+            CallAwaiter(PipelinedClient& client, std::string methodName, Request::Parameters params, Clock::duration timeout)
+                : myClient(client), myMethodName(std::move(methodName)), myParams(std::move(params)), myTimeout(timeout) {
+            }
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> awaiting) {
+                PipelinedClient& client = myClient;
+                if (!client.mySend) {
+                    throw std::logic_error("PipelinedClient::AsyncCall needs a send function");
+                }
+
+                Call call = client.BuildRequestData(myMethodName, myParams, [this, awaiting](Response response) {
+                    myResponse.emplace(std::move(response));
+                    awaiting.resume();
+                }, myTimeout);
+
+                // the response may resume the coroutine (and destroy this) before send returns: only locals from here
+                try {
+                    client.mySend(call.data);
+                }
+                catch (...) {
+                    // unless the call was resolved meanwhile, the coroutine resumes with the exception
+                    if (client.Forget(call.id)) {
+                        throw;
+                    }
+                }
+            }
+
+            Value await_resume() {
+                myResponse->ThrowIfFault();
+                return std::move(myResponse->GetResult());
+            }
+
+        private:
+            PipelinedClient& myClient;
+            std::string myMethodName;
+            Request::Parameters myParams;
+            Clock::duration myTimeout;
+            std::optional<Response> myResponse;
+        };
+#endif
+
+        // Resolves the call the response answers. Returns false if it answers no pending call (it timed out,
+        // was cancelled, or the server could not read the request and sent no id or a null one) or isn't a
+        // response at all. Throws if the data can't be parsed.
+        bool HandleResponse(const std::string& aResponseData) {
+            return HandleResponseInternal(myFormatHandler.CreateReader(aResponseData));
+        }
+
+        bool HandleResponse(const char* aResponseData, size_t aSize) {
+            return HandleResponseInternal(myFormatHandler.CreateReader(aResponseData, aSize));
+        }
+
+        // The callback is called with a CANCELLED fault; returns false if the call is not pending anymore
+        bool Cancel(int32_t id) {
+            return Complete(id, [id] { return Response(CANCELLED, "Request cancelled", Value(id)); });
+        }
+
+        // Fails the calls whose timeout has passed with TIMED_OUT; call it now and then (e.g. from the event
+        // loop's timer). Returns the number of calls that timed out.
+        size_t ExpireTimedOut(Clock::time_point now = Clock::now()) {
+            std::vector<std::pair<int32_t, ResponseCallback>> expired;
+            {
+                std::lock_guard<std::mutex> lock(myMutex);
+                for (auto it = myPending.begin(); it != myPending.end();) {
+                    if (it->second.deadline <= now) {
+                        expired.emplace_back(it->first, std::move(it->second.onResponse));
+                        it = myPending.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+            for (auto& call : expired) {
+                call.second(Response(TIMED_OUT, "Request timed out", Value(call.first)));
+            }
+            return expired.size();
+        }
+
+        size_t GetPendingCount() const {
+            std::lock_guard<std::mutex> lock(myMutex);
+            return myPending.size();
+        }
+
+    private:
+        struct Pending {
+            ResponseCallback onResponse;
+            Clock::time_point deadline;
+        };
+
+        bool HandleResponseInternal(std::unique_ptr<Reader> reader) {
+            // the server's faults for requests it could not read have no id, which readers refuse
+            Response response{ Value(), Value() };
+            try {
+                response = reader->GetResponse();
+            } catch (const Fault&) {
+                return false;
+            }
+            reader.reset();
+
+            const Value& id = response.GetId();
+            if (!id.IsInt32()) {
+                return false;
+            }
+            return Complete(id.AsInt32(), [&] { return std::move(response); });
+        }
+
+        // Drops the call without calling its callback; false if it is not pending anymore
+        bool Forget(int32_t id) {
+            std::lock_guard<std::mutex> lock(myMutex);
+            return myPending.erase(id) > 0;
+        }
+
+        template<typename MakeResponseType>
+        bool Complete(int32_t id, MakeResponseType makeResponse) {
+            ResponseCallback onResponse;
+            {
+                std::lock_guard<std::mutex> lock(myMutex);
+                auto it = myPending.find(id);
+                if (it == myPending.end()) {
+                    return false;
+                }
+                onResponse = std::move(it->second.onResponse);
+                myPending.erase(it);
+            }
+
+            onResponse(makeResponse());
+            return true;
+        }
+
+        FormatHandler& myFormatHandler;
+        SendFunction mySend;
+        std::atomic<int32_t> myId;
+        mutable std::mutex myMutex;
+        std::unordered_map<int32_t, Pending> myPending;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_PIPELINEDCLIENT_H
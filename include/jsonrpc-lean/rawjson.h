@@ -0,0 +1,102 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef JSONRPC_LEAN_RAWJSON_H
+#define JSONRPC_LEAN_RAWJSON_H
+
+#include "fault.h"
+#include "writer.h"
+
+#define RAPIDJSON_NO_SIZETYPEDEFINE
+namespace rapidjson { typedef ::std::size_t SizeType; }
+
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace jsonrpc {
+
+    namespace detail {
+
+        // Replays rapidjson's parsing events as writes, numbers and strings becoming what the readers make of them
+        struct RawJsonHandler {
+            Writer& writer;
+            // whether each container is a struct, whose elements are ended after their value
+            std::vector<bool> isStruct;
+
+            bool EndValue() {
+                if (!isStruct.empty() && isStruct.back()) {
+                    writer.EndStructElement();
+                }
+                return true;
+            }
+
+            bool Null() { writer.WriteNull(); return EndValue(); }
+            bool Bool(bool value) { writer.Write(value); return EndValue(); }
+            bool Int(int value) { writer.Write(static_cast<int32_t>(value)); return EndValue(); }
+            bool Uint(unsigned value) { writer.Write(static_cast<int64_t>(value)); return EndValue(); }
+            bool Int64(int64_t value) { writer.Write(value); return EndValue(); }
+            bool Uint64(uint64_t value) {
+                if (value > static_cast<uint64_t>(INT64_MAX)) {
+                    writer.Write(static_cast<double>(value));
+                } else {
+                    writer.Write(static_cast<int64_t>(value));
+                }
+                return EndValue();
+            }
+            bool Double(double value) { writer.Write(value); return EndValue(); }
+            bool RawNumber(const char*, rapidjson::SizeType, bool) { return false; }
+            bool String(const char* value, rapidjson::SizeType size, bool) {
+                if (memchr(value, '\0', size) != nullptr) {
+                    writer.WriteBinary(value, size);
+                } else {
+                    writer.Write(std::string(value, size));
+                }
+                return EndValue();
+            }
+            bool StartObject() { writer.StartStruct(); isStruct.push_back(true); return true; }
+            bool Key(const char* name, rapidjson::SizeType size, bool) {
+                writer.StartStructElement(std::string(name, size));
+                return true;
+            }
+            bool EndObject(rapidjson::SizeType) { isStruct.pop_back(); writer.EndStruct(); return EndValue(); }
+            bool StartArray() { writer.StartArray(); isStruct.push_back(false); return true; }
+            bool EndArray(rapidjson::SizeType) { isStruct.pop_back(); writer.EndArray(); return EndValue(); }
+        };
+
+    } // namespace detail
+
+    // Writes the value held by the JSON text data to writer, value by value; for the WriteRawJson of writers
+    // that can't copy JSON text as it is
+    inline void ReplayRawJson(Writer& writer, const char* data, size_t size) {
+        rapidjson::MemoryStream stream(data, size);
+        detail::RawJsonHandler handler{ writer, {} };
+        rapidjson::Reader reader;
+        if (reader.Parse<rapidjson::kParseDefaultFlags>(stream, handler).IsError()) {
+            throw InternalErrorFault("invalid raw JSON value");
+        }
+    }
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_RAWJSON_H
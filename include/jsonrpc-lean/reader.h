@@ -20,18 +20,68 @@
 #ifndef JSONRPC_LEAN_READER_H
 #define JSONRPC_LEAN_READER_H
 
+#include "fault.h"
+#include "request.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
 namespace jsonrpc {
 
-    class Request;
     class Response;
     class Value;
 
     class Reader {
     public:
+        // Reads up to size bytes of input into buffer and returns how many it read, 0 at the end of the input
+        typedef std::function<size_t(char* buffer, size_t size)> ReadFunction;
+
         virtual ~Reader() {}
 
+        // The requests hold their parameters themselves, they may outlive the Reader
+
         virtual Request GetRequest() = 0;
+
+        // Batch (the document is an array of requests)
+        virtual bool IsBatch() = 0;
+        virtual size_t GetBatchSize() = 0;
+        virtual Request GetBatchRequest(size_t index) = 0;
+
+        // Like GetRequest and GetBatchRequest, but the parameters may be left in the Reader's document and only
+        // converted when they are used (see Request::GetParametersView), so the Reader must outlive the requests.
+        // Readers that can do so override these, by default they are the same as the others.
+        virtual Request GetRequestView() {
+            return GetRequest();
+        }
+
+        virtual Request GetBatchRequestView(size_t index) {
+            return GetBatchRequest(index);
+        }
+
+        // Like GetRequestView and GetBatchRequestView, but a request that isn't valid is reported in fault (and an
+        // empty request returned) instead of thrown. These implementations catch what the others throw, readers
+        // that see a lot of untrusted input override them not to throw at all.
+        virtual Request TryGetRequestView(FaultStatus& fault) {
+            try {
+                return GetRequestView();
+            } catch (const Fault& ex) {
+                fault = ex;
+                return Request(std::string(), ValueView(), Value());
+            }
+        }
+
+        virtual Request TryGetBatchRequestView(size_t index, FaultStatus& fault) {
+            try {
+                return GetBatchRequestView(index);
+            } catch (const Fault& ex) {
+                fault = ex;
+                return Request(std::string(), ValueView(), Value());
+            }
+        }
+
         virtual Response GetResponse() = 0;
+        virtual Response GetBatchResponse(size_t index) = 0;
         virtual Value GetValue() = 0;
     };
 
@@ -21,6 +21,7 @@
 #define JSONRPC_LEAN_REQUEST_H
 
 #include "value.h"
+#include "valueview.h"
 
 #include <deque>
 #include <string>
@@ -40,16 +41,76 @@ namespace jsonrpc {
             // Empty
         }
 
+        // The parameters are left where parameters points to (e.g. in a Reader's document, which must
+        // outlive this request) and are converted to Values the first time GetParameters() is called.
+        // An undefined view means there are no parameters.
+        Request(std::string methodName, ValueView parameters, Value id)
+            : myMethodName(std::move(methodName)),
+            myParametersView(parameters.IsUndefined() ? ValueView() : parameters),
+            myId(std::move(id)) {
+            // Empty
+        }
+
         const std::string& GetMethodName() const { return myMethodName; }
-        const Parameters& GetParameters() const { return myParameters; }
+
+        const Parameters& GetParameters() const {
+            // parameters by name are only put in order by the method they are for
+            if (myParametersView.IsArray() && myParameters.empty()) {
+                for (size_t i = 0; i < myParametersView.Size(); ++i) {
+                    myParameters.emplace_back(myParametersView[i].ToValue());
+                }
+            }
+            return myParameters;
+        }
+
+        // Does not convert anything; the view is only valid as long as this request (and what it was read from)
+        ValueView GetParametersView() const {
+            if (!myParametersView.IsUndefined()) {
+                return myParametersView;
+            }
+            return myNamedParameters.IsObject() ? ValueView(myNamedParameters) : ValueView(myParameters);
+        }
+
+        // Like GetParametersView, but the parameters this request holds itself (not those left in a Reader's
+        // document) may be moved out by whoever converts them, as Dispatcher::Invoke does for an rvalue request
+        ValueView TakeParametersView() {
+            if (!myParametersView.IsUndefined()) {
+                return myParametersView;
+            }
+            return myNamedParameters.IsObject() ? ValueView(myNamedParameters) : ValueView::TakeFrom(myParameters);
+        }
+
+        // Converts the parameters still left where the view given to the constructor points to, so the request
+        // no longer depends on what it was read from
+        void DetachParameters() {
+            if (myParametersView.IsArray()) {
+                GetParameters();
+            } else if (myParametersView.IsObject()) {
+                myNamedParameters = myParametersView.ToValue();
+            }
+            myParametersView = ValueView();
+        }
+
         const Value& GetId() const { return myId; }
 
-        void Write(Writer& writer) const {
-            Write(myMethodName, myParameters, myId, writer);
+        // Leaves the request without an id
+        Value TakeId() { return std::move(myId); }
+
+        template<typename WriterType>
+        void Write(WriterType& writer) const {
+            Write(myMethodName, GetParameters(), myId, writer);
         }
 
-        static void Write(const std::string& methodName, const Parameters& params, const Value& id, Writer& writer) {
+        template<typename WriterType>
+        static void Write(const std::string& methodName, const Parameters& params, const Value& id, WriterType& writer) {
             writer.StartDocument();
+            WriteRequest(methodName, params, id, writer);
+            writer.EndDocument();
+        }
+
+        // Without the document around it, to be one element of a batch
+        template<typename WriterType>
+        static void WriteRequest(const std::string& methodName, const Parameters& params, const Value& id, WriterType& writer) {
             writer.StartRequest(methodName, id);
             for (auto& param : params) {
                 writer.StartParameter();
@@ -57,12 +118,14 @@ namespace jsonrpc {
                 writer.EndParameter();
             }
             writer.EndRequest();
-            writer.EndDocument();
         }
 
     private:
         std::string myMethodName;
-        Parameters myParameters;
+        mutable Parameters myParameters;
+        // by name, once detached from the view
+        Value myNamedParameters;
+        ValueView myParametersView;
         Value myId;
     };
 
@@ -22,6 +22,9 @@
 
 #include "value.h"
 
+#include <memory>
+#include <string>
+
 namespace jsonrpc {
 
     class Writer;
@@ -40,22 +43,43 @@ namespace jsonrpc {
             myId(std::move(id)) {
         }
 
-        void Write(Writer& writer) const {
+        // Result already written in the format of the writer it goes to (see Writer::WriteRaw), as kept by
+        // ResponseCache; GetResult is undefined then
+        Response(std::shared_ptr<const std::string> rawResult, Value id) : myIsFault(false),
+            myFaultCode(0),
+            myId(std::move(id)),
+            myRawResult(std::move(rawResult)) {
+        }
+
+        template<typename WriterType>
+        void Write(WriterType& writer) const {
             writer.StartDocument();
+            WriteResponse(writer);
+            writer.EndDocument();
+        }
+
+        // Writes only the response itself, e.g. as one element of a batch
+        template<typename WriterType>
+        void WriteResponse(WriterType& writer) const {
             if (myIsFault) {
                 writer.StartFaultResponse(myId);
                 writer.WriteFault(myFaultCode, myFaultString);
                 writer.EndFaultResponse();
             } else {
                 writer.StartResponse(myId);
-                myResult.Write(writer);
+                if (myRawResult) {
+                    writer.WriteRaw(myRawResult->data(), myRawResult->size());
+                } else {
+                    myResult.Write(writer);
+                }
                 writer.EndResponse();
             }
-            writer.EndDocument();
         }
 
         Value& GetResult() { return myResult; }
         bool IsFault() const { return myIsFault; }
+        int32_t GetFaultCode() const { return myFaultCode; }
+        const std::shared_ptr<const std::string>& GetRawResult() const { return myRawResult; }
 
         void ThrowIfFault() const {
             if (!IsFault()) {
@@ -100,6 +124,7 @@ namespace jsonrpc {
         int32_t myFaultCode;
         std::string myFaultString;
         Value myId;
+        std::shared_ptr<const std::string> myRawResult;
     };
 
 } // namespace jsonrpc
@@ -0,0 +1,219 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_RESPONSECACHE_H
+#define JSONRPC_LEAN_RESPONSECACHE_H
+
+#include "valueview.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jsonrpc {
+
+    // Results of one method, already written in the format they were asked in, keyed by the parameters they
+    // were computed from (see AppendKey). An LRU split into shards with a lock each, so threads looking up
+    // different keys seldom wait for each other; the maximum number of entries is split between them too, so
+    // a shard may evict before the whole cache is full. Entries are dropped once older than the time to live.
+    class ResponseCache {
+    public:
+        typedef std::chrono::steady_clock Clock;
+        typedef std::shared_ptr<const std::string> Result;
+
+        ResponseCache(Clock::duration timeToLive, size_t maximumEntries)
+            : myTimeToLive(timeToLive), myShardCapacity((maximumEntries + SHARD_COUNT - 1) / SHARD_COUNT) {
+            myHits.store(0, std::memory_order_relaxed);
+            myMisses.store(0, std::memory_order_relaxed);
+        }
+
+        ResponseCache(const ResponseCache&) = delete;
+        ResponseCache& operator=(const ResponseCache&) = delete;
+
+        // Appends an encoding of params to key that is the same for equal parameters: the type of every value
+        // and its content, with members of objects sorted by name
+        static void AppendKey(const ValueView& params, std::string& key) {
+            const Value::Type type = params.GetType();
+            key.push_back(static_cast<char>(type));
+            switch (type) {
+            case Value::TYPE_BOOLEAN:
+                key.push_back(params.AsBoolean() ? 1 : 0);
+                break;
+            case Value::TYPE_INT32: {
+                const int32_t value = params.AsInt32();
+                key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+                break;
+            }
+            case Value::TYPE_DOUBLE: {
+                const double value = params.AsDouble();
+                key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+                break;
+            }
+            case Value::TYPE_STRING: {
+                size_t size;
+                const char* string = params.GetString(size);
+                AppendSized(string, size, key);
+                break;
+            }
+            case Value::TYPE_ARRAY:
+                AppendSize(params.Size(), key);
+                for (size_t i = 0; i < params.Size(); ++i) {
+                    AppendKey(params[i], key);
+                }
+                break;
+            case Value::TYPE_OBJECT: {
+                struct Member {
+                    const char* name;
+                    size_t nameSize;
+                    ValueView value;
+                };
+                std::vector<Member> members;
+                members.reserve(params.Size());
+                params.ForEachMember([&](const char* name, size_t nameSize, const ValueView& value) {
+                    members.push_back({ name, nameSize, value });
+                });
+                std::sort(members.begin(), members.end(), [](const Member& a, const Member& b) {
+                    const int order = memcmp(a.name, b.name, std::min(a.nameSize, b.nameSize));
+                    return order != 0 ? order < 0 : a.nameSize < b.nameSize;
+                });
+
+                AppendSize(members.size(), key);
+                for (auto& member : members) {
+                    AppendSized(member.name, member.nameSize, key);
+                    AppendKey(member.value, key);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        // NULL if there is no result for key, or it has expired
+        Result Find(const std::string& key) {
+            Shard& shard = GetShard(key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto found = shard.entries.find(key);
+            if (found == shard.entries.end()) {
+                myMisses.fetch_add(1, std::memory_order_relaxed);
+                return Result();
+            }
+            if (Clock::now() >= found->second.expiry) {
+                shard.order.erase(found->second.position);
+                shard.entries.erase(found);
+                myMisses.fetch_add(1, std::memory_order_relaxed);
+                return Result();
+            }
+
+            // most recently used at the front
+            shard.order.splice(shard.order.begin(), shard.order, found->second.position);
+            myHits.fetch_add(1, std::memory_order_relaxed);
+            return found->second.result;
+        }
+
+        // Replaces what key had, and drops the least recently used entry of its shard if that one is full
+        void Insert(std::string key, Result result) {
+            if (myShardCapacity == 0) {
+                return;
+            }
+
+            Shard& shard = GetShard(key);
+            const Clock::time_point expiry = Clock::now() + myTimeToLive;
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto inserted = shard.entries.emplace(std::move(key), Entry());
+            Entry& entry = inserted.first->second;
+            entry.result = std::move(result);
+            entry.expiry = expiry;
+            if (!inserted.second) {
+                shard.order.splice(shard.order.begin(), shard.order, entry.position);
+                return;
+            }
+
+            shard.order.push_front(&inserted.first->first);
+            entry.position = shard.order.begin();
+            if (shard.entries.size() > myShardCapacity) {
+                // by iterator, the key lives in the node being erased
+                shard.entries.erase(shard.entries.find(*shard.order.back()));
+                shard.order.pop_back();
+            }
+        }
+
+        // e.g. once what the method reads has changed
+        void Clear() {
+            for (auto& shard : myShards) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.entries.clear();
+                shard.order.clear();
+            }
+        }
+
+        uint64_t GetHitCount() const { return myHits.load(std::memory_order_relaxed); }
+        uint64_t GetMissCount() const { return myMisses.load(std::memory_order_relaxed); }
+
+    private:
+        static const size_t SHARD_COUNT = 16;
+
+        struct Entry {
+            Result result;
+            Clock::time_point expiry;
+            // of the entry's key in Shard::order
+            std::list<const std::string*>::iterator position;
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            // keys of the entries (which stay put in the map), most recently used first
+            std::list<const std::string*> order;
+            std::unordered_map<std::string, Entry> entries;
+        };
+
+        static void AppendSize(size_t size, std::string& key) {
+            const uint64_t value = size;
+            key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        static void AppendSized(const char* data, size_t size, std::string& key) {
+            AppendSize(size, key);
+            key.append(data, size);
+        }
+
+        Shard& GetShard(const std::string& key) {
+            // the low bits pick the bucket within the shard's map, use others for the shard
+            return myShards[(std::hash<std::string>()(key) >> 16) % SHARD_COUNT];
+        }
+
+        const Clock::duration myTimeToLive;
+        const size_t myShardCapacity;
+        std::atomic<uint64_t> myHits;
+        std::atomic<uint64_t> myMisses;
+        Shard myShards[SHARD_COUNT];
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_RESPONSECACHE_H
@@ -20,6 +20,7 @@
 #ifndef JSONRPC_LEAN_SERVER_H
 #define JSONRPC_LEAN_SERVER_H
 
+#include "compat.h"
 #include "request.h"
 #include "value.h"
 #include "fault.h"
@@ -31,14 +32,31 @@
 #include "formatteddata.h"
 #include "jsonformatteddata.h"
 #include "dispatcher.h"
+#include "metrics.h"
+#include "outputbuffer.h"
+#include "outputsink.h"
+#include "parselimits.h"
+#include "snapshot.h"
+#include "staticdispatcher.h"
 
 
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 namespace jsonrpc {
 
     class Server {
     public:
+        // Must call task(0) ... task(count - 1), possibly concurrently, and return only once all of them have completed
+        typedef std::function<void(size_t count, const std::function<void(size_t)>& task)> BatchExecutor;
+        // Gets the formatted response of HandleRequestAsync, NULL if no FormatHandler is found
+        typedef std::function<void(std::shared_ptr<FormattedData> response)> ResponseCallback;
+
         Server() {}
         ~Server() {}
 
@@ -47,51 +65,466 @@ namespace jsonrpc {
         Server(Server&&) = delete;
         Server& operator=(Server&&) = delete;
 
+        // Requests may be handled from any number of threads. Format handlers can be registered meanwhile, and methods
+        // too once the dispatcher is in concurrent mode (Dispatcher::SetConcurrent); the other settings must be
+        // made before requests are handled.
         void RegisterFormatHandler(FormatHandler& formatHandler) {
-            myFormatHandlers.push_back(&formatHandler);
+            if (myHasParseLimits) {
+                formatHandler.SetParseLimits(myParseLimits);
+            }
+            myFormatHandlers.Update([&](std::vector<FormatHandler*>& handlers) { handlers.push_back(&formatHandler); });
+        }
+
+        // Of every format handler, those registered already and those registered later (see ParseLimits)
+        void SetParseLimits(const ParseLimits& parseLimits) {
+            myParseLimits = parseLimits;
+            myHasParseLimits = true;
+            for (auto handler : myFormatHandlers.Get()) {
+                handler->SetParseLimits(parseLimits);
+            }
         }
 
         Dispatcher& GetDispatcher() { return myDispatcher; }
 
+        // Batches with at least minimumBatchSize calls are dispatched through executor instead of sequentially.
+        // Not synchronised with request handling: set (or reset) it before any request is served or once
+        // they are all done, like the format handlers.
+        void SetBatchExecutor(BatchExecutor executor, size_t minimumBatchSize = 16) {
+            myBatchExecutor = std::move(executor);
+            myMinimumParallelBatchSize = minimumBatchSize;
+        }
+
+        // Requests for methods of staticMethods (a StaticDispatcher, which must outlive the server) are answered
+        // by it, the others by GetDispatcher(). Set it before requests are handled, NULL to stop using one.
+        void SetStaticMethods(const StaticMethods* staticMethods) {
+            myStaticMethods = staticMethods;
+        }
+
         // aContentType is here to allow future implementation of other rpc formats with minimal code changes
         // Will return NULL if no FormatHandler is found, otherwise will return a FormatedData
         // If aRequestData is a Notification (the client doesn't expect a response), the returned FormattedData will have an empty ->GetData() buffer and ->GetSize() will be 0
+        // If aRequestData is a batch, all responses are written as one array; notifications are left out, and if the batch held only notifications the buffer is empty
         std::shared_ptr<jsonrpc::FormattedData> HandleRequest(const std::string& aRequestData, const std::string& aContentType = "application/json") {
+            return HandleRequestInternal(aContentType, aRequestData.size(), [&](FormatHandler& handler, FaultStatus& parseError) { return handler.CreateReader(aRequestData.data(), aRequestData.size(), parseError); });
+        }
 
-            // first find the correct handler
-            FormatHandler *fmtHandler = nullptr;
-            for (auto handler : myFormatHandlers) {
-                if (handler->CanHandleRequest(aContentType)) {
-                    fmtHandler = handler;
+        // Reads aRequestData straight from the caller's buffer, without copying it into a std::string first
+        std::shared_ptr<jsonrpc::FormattedData> HandleRequest(const char* aRequestData, size_t aSize, const std::string& aContentType = "application/json") {
+            return HandleRequestInternal(aContentType, aSize, [&](FormatHandler& handler, FaultStatus& parseError) { return handler.CreateReader(aRequestData, aSize, parseError); });
+        }
+
+        // Like the overload above, but the FormatHandler may parse aRequestData in place (decoding strings inside the buffer)
+        // aRequestData[aSize] must be '\0', and the buffer content is undefined after the call
+        std::shared_ptr<jsonrpc::FormattedData> HandleRequestInsitu(char* aRequestData, size_t aSize, const std::string& aContentType = "application/json") {
+            return HandleRequestInternal(aContentType, aSize, [&](FormatHandler& handler, FaultStatus& parseError) { return handler.CreateInsituReader(aRequestData, aSize, parseError); });
+        }
+
+        // Write the response into aOutput instead of a new FormattedData, reusing the capacity it already has
+        // (keep one OutputBuffer per connection, or take them from an OutputBufferPool). aOutput is left empty
+        // for notifications. Returns false if no FormatHandler is found.
+        bool HandleRequest(const std::string& aRequestData, OutputBuffer& aOutput, const std::string& aContentType = "application/json") {
+            return HandleRequestInternal(aContentType, aRequestData.size(), [&](FormatHandler& handler, FaultStatus& parseError) { return handler.CreateReader(aRequestData.data(), aRequestData.size(), parseError); }, aOutput);
+        }
+
+        bool HandleRequest(const char* aRequestData, size_t aSize, OutputBuffer& aOutput, const std::string& aContentType = "application/json") {
+            return HandleRequestInternal(aContentType, aSize, [&](FormatHandler& handler, FaultStatus& parseError) { return handler.CreateReader(aRequestData, aSize, parseError); }, aOutput);
+        }
+
+        // Hands the response to aSink while it is being written, a chunk at a time (see OutputSink), instead of
+        // holding all of it. Formats that can't be streamed, such as MessagePack (whose containers start with
+        // their size), are handed over in one piece once written. Nothing is written for notifications.
+        // Returns false if no FormatHandler is found.
+        bool HandleRequest(const std::string& aRequestData, OutputSink& aSink, const std::string& aContentType = "application/json") {
+            return HandleRequestInternal(aContentType, aRequestData.size(), [&](FormatHandler& handler, FaultStatus& parseError) { return handler.CreateReader(aRequestData.data(), aRequestData.size(), parseError); }, aSink);
+        }
+
+        bool HandleRequest(const char* aRequestData, size_t aSize, OutputSink& aSink, const std::string& aContentType = "application/json") {
+            return HandleRequestInternal(aContentType, aSize, [&](FormatHandler& handler, FaultStatus& parseError) { return handler.CreateReader(aRequestData, aSize, parseError); }, aSink);
+        }
+
+        // Pulls the request through aRead while parsing it (e.g. straight from a socket), so large requests are
+        // never held in memory as text
+        std::shared_ptr<jsonrpc::FormattedData> HandleRequestStream(const Reader::ReadFunction& aRead, const std::string& aContentType = "application/json") {
+            return HandleRequestInternal(aContentType, UNKNOWN_SIZE, [&](FormatHandler& handler, FaultStatus&) { return handler.CreateStreamReader(aRead); });
+        }
+
+        // Starts the request and returns without waiting for asynchronous methods (see Dispatcher::AddAsyncMethod):
+        // onComplete is called once the response is written, from the thread completing the last call. It is
+        // called before returning when nothing is asynchronous.
+        void HandleRequestAsync(const std::string& aRequestData, const std::string& aContentType, ResponseCallback onComplete) {
+            FormatHandler* fmtHandler = FindFormatHandler(aContentType);
+            if (fmtHandler == nullptr) {
+                onComplete(nullptr);
+                return;
+            }
+
+            Metrics* metrics = myDispatcher.GetMetrics();
+            if (metrics != nullptr) {
+                metrics->GetRequestSize().Record(aRequestData.size());
+                onComplete = [metrics, callback = std::move(onComplete)](std::shared_ptr<FormattedData> response) {
+                    metrics->GetResponseSize().Record(response->GetSize());
+                    callback(std::move(response));
+                };
+            }
+
+            try {
+                // the reader only has to outlive the dispatching, methods copy what they need to keep
+                MetricsTimer parseTimer(metrics != nullptr ? &metrics->GetParseTime() : nullptr);
+                FaultStatus fault;
+                auto reader = fmtHandler->CreateReader(aRequestData.data(), aRequestData.size(), fault);
+                if (!fault && reader->IsBatch() && reader->GetBatchSize() > 0) {
+                    HandleBatchAsync(*reader, *fmtHandler, std::move(onComplete), parseTimer);
+                    return;
                 }
+
+                Request request = fault ? Request(std::string(), ValueView(), Value()) : reader->TryGetRequestView(fault);
+                parseTimer.Stop();
+                if (fault) {
+                    auto writer = fmtHandler->CreateWriter();
+                    Response(fault.GetCode(), fault.GetString(), Value()).Write(*writer);
+                    onComplete(writer->GetData());
+                    return;
+                }
+
+                auto respond = [fmtHandler, metrics, onComplete](Response response) {
+                    auto writer = fmtHandler->CreateWriter();
+                    if (!IsNotification(response)) {
+                        MetricsTimer serialiseTimer(metrics != nullptr ? &metrics->GetSerialiseTime() : nullptr);
+                        WriteStatic(*writer, [&](auto& w) { response.Write(w); });
+                    }
+                    onComplete(writer->GetData());
+                };
+
+                Response staticResponse{ Value(), Value() };
+                if (InvokeStatic(request, staticResponse)) {
+                    respond(std::move(staticResponse));
+                    return;
+                }
+                auto method = myDispatcher.GetMethodHandle(request.GetMethodName());
+                if (!method || !method.GetMethod().IsAsync()) {
+                    respond(Invoke(*fmtHandler, method, std::move(request)));
+                } else {
+                    myDispatcher.InvokeAsync(request, respond);
+                }
+            } catch (const Fault& ex) {
+                auto writer = fmtHandler->CreateWriter();
+                Response(ex.GetCode(), ex.GetString(), Value()).Write(*writer);
+                onComplete(writer->GetData());
             }
+        }
+
+#ifdef JSONRPC_LEAN_HAS_STRING_VIEW
+        // Only takes a std::string_view itself, so string literals still go to the std::string overload
+        // instead of being ambiguous between the two
+        template<typename StringView, typename = typename std::enable_if<std::is_same<StringView, std::string_view>::value>::type>
+        std::shared_ptr<jsonrpc::FormattedData> HandleRequest(StringView aRequestData, const std::string& aContentType = "application/json") {
+            return HandleRequest(aRequestData.data(), aRequestData.size(), aContentType);
+        }
+#endif
+
+    private:
+        // Size of a request read from a stream
+        static const size_t UNKNOWN_SIZE = static_cast<size_t>(-1);
 
+        template<typename CreateReaderType>
+        std::shared_ptr<jsonrpc::FormattedData> HandleRequestInternal(const std::string& aContentType, size_t aRequestSize, CreateReaderType createReader) {
+            FormatHandler* fmtHandler = FindFormatHandler(aContentType);
             if (fmtHandler == nullptr) {
                 // no FormatHandler able to handle this request type was found
                 return nullptr;
             }
-            
+
             auto writer = fmtHandler->CreateWriter();
+            HandleRequestInternal(*fmtHandler, createReader, *writer);
+            auto data = writer->GetData();
+            RecordSizes(aRequestSize, data->GetSize());
+            return data;
+        }
+
+        template<typename CreateReaderType>
+        bool HandleRequestInternal(const std::string& aContentType, size_t aRequestSize, CreateReaderType createReader, OutputBuffer& aOutput) {
+            FormatHandler* fmtHandler = FindFormatHandler(aContentType);
+            if (fmtHandler == nullptr) {
+                return false;
+            }
+
+            auto writer = fmtHandler->CreateWriter(aOutput.Take());
+            HandleRequestInternal(*fmtHandler, createReader, *writer);
+            aOutput.Put(writer->GetData()->ReleaseBuffer());
+            RecordSizes(aRequestSize, aOutput.GetSize());
+            return true;
+        }
+
+        template<typename CreateReaderType>
+        bool HandleRequestInternal(const std::string& aContentType, size_t aRequestSize, CreateReaderType createReader, OutputSink& aSink) {
+            FormatHandler* fmtHandler = FindFormatHandler(aContentType);
+            if (fmtHandler == nullptr) {
+                return false;
+            }
+
+            const size_t sizeBefore = aSink.GetSize();
+            if (auto writer = fmtHandler->CreateWriter(aSink)) {
+                HandleRequestInternal(*fmtHandler, createReader, *writer);
+            } else {
+                auto bufferedWriter = fmtHandler->CreateWriter();
+                HandleRequestInternal(*fmtHandler, createReader, *bufferedWriter);
+                auto data = bufferedWriter->GetData();
+                if (data->GetSize() > 0) {
+                    aSink.Append(data->GetData(), data->GetSize());
+                }
+            }
+            RecordSizes(aRequestSize, aSink.GetSize() - sizeBefore);
+            return true;
+        }
+
+        template<typename CreateReaderType>
+        void HandleRequestInternal(FormatHandler& fmtHandler, CreateReaderType createReader, Writer& writer) {
+            Metrics* metrics = myDispatcher.GetMetrics();
 
             try {
-                auto reader = fmtHandler->CreateReader(aRequestData);
-                Request request = reader->GetRequest();
+                // invalid input is answered without throwing, the catch is for readers and methods that do throw
+                MetricsTimer parseTimer(metrics != nullptr ? &metrics->GetParseTime() : nullptr);
+                FaultStatus fault;
+                auto reader = createReader(fmtHandler, fault);
+                if (!fault && reader->IsBatch() && reader->GetBatchSize() > 0) {
+                    HandleBatch(*reader, fmtHandler, writer, parseTimer);
+                    return;
+                }
+
+                // the request may still point into the reader's document, keep it until the method returns
+                Request request = fault ? Request(std::string(), ValueView(), Value()) : reader->TryGetRequestView(fault);
+                parseTimer.Stop();
+                if (fault) {
+                    Response(fault.GetCode(), fault.GetString(), Value()).Write(writer);
+                    return;
+                }
+                auto response = Invoke(fmtHandler, std::move(request));
                 reader.reset();
 
-                auto response = myDispatcher.Invoke(request.GetMethodName(), request.GetParameters(), request.GetId());
-                if (!response.GetId().IsBoolean() || response.GetId().AsBoolean() != false) {
-                    // if Id is false, this is a notification and we don't have to write a response
-                    response.Write(*writer);
+                if (!IsNotification(response)) {
+                    MetricsTimer serialiseTimer(metrics != nullptr ? &metrics->GetSerialiseTime() : nullptr);
+                    WriteStatic(writer, [&](auto& w) { response.Write(w); });
                 }
             } catch (const Fault& ex) {
-                Response(ex.GetCode(), ex.GetString(), Value()).Write(*writer);
+                Response(ex.GetCode(), ex.GetString(), Value()).Write(writer);
             }
+        }
 
-            return writer->GetData();
+        // False if there are no static methods or request isn't for one of them
+        bool InvokeStatic(Request& request, Response& response) const {
+            return myStaticMethods != nullptr && myStaticMethods->TryInvoke(request, response);
         }
-    private:
+
+        Response Invoke(FormatHandler& fmtHandler, Request&& request) const {
+            Response response{ Value(), Value() };
+            if (InvokeStatic(request, response)) {
+                return response;
+            }
+            return Invoke(fmtHandler, myDispatcher.GetMethodHandle(request.GetMethodName()), std::move(request));
+        }
+
+        // Cacheable methods are answered from their cache if they can be, and their results kept in the format of
+        // fmtHandler otherwise; the others are just invoked
+        Response Invoke(FormatHandler& fmtHandler, const MethodHandle& method, Request&& request) const {
+            // notifications have false as id, and still call the method
+            ResponseCache* cache = method && !method.GetMethod().IsAsync() && !request.GetId().IsBoolean() ? method.GetMethod().GetCache() : nullptr;
+            if (cache == nullptr) {
+                return myDispatcher.Invoke(method, std::move(request));
+            }
+
+            // each format has results of its own, told apart by content type (the handler's address could be
+            // another format's once it is gone)
+            std::string key = fmtHandler.GetContentType();
+            key += '\0';
+            ResponseCache::AppendKey(request.GetParametersView(), key);
+            if (auto result = cache->Find(key)) {
+                return Response(std::move(result), request.TakeId());
+            }
+
+            Response response = myDispatcher.Invoke(method, std::move(request));
+            if (response.IsFault()) {
+                return response;
+            }
+            auto writer = fmtHandler.CreateWriter();
+            WriteStatic(*writer, [&](auto& w) { response.GetResult().Write(w); });
+            ResponseCache::Result result = std::make_shared<const std::string>(writer->GetData()->ReleaseBuffer());
+            cache->Insert(std::move(key), result);
+            return Response(std::move(result), Value(response.GetId()));
+        }
+
+        void RecordSizes(size_t aRequestSize, size_t aResponseSize) {
+            if (Metrics* metrics = myDispatcher.GetMetrics()) {
+                if (aRequestSize != UNKNOWN_SIZE) {
+                    metrics->GetRequestSize().Record(aRequestSize);
+                }
+                metrics->GetResponseSize().Record(aResponseSize);
+            }
+        }
+
+        FormatHandler* FindFormatHandler(const std::string& aContentType) const {
+            FormatHandler* fmtHandler = nullptr;
+            for (auto handler : myFormatHandlers.Get()) {
+                if (handler->CanHandleRequest(aContentType)) {
+                    fmtHandler = handler;
+                }
+            }
+            return fmtHandler;
+        }
+
+        static bool IsNotification(const Response& response) {
+            // if Id is false, this is a notification and we don't have to write a response
+            return response.GetId().IsBoolean() && response.GetId().AsBoolean() == false;
+        }
+
+        // parseTimer is stopped once all the calls have been read
+        void HandleBatch(Reader& reader, FormatHandler& fmtHandler, Writer& writer, MetricsTimer& parseTimer) const {
+            const size_t size = reader.GetBatchSize();
+
+            // Invalid elements are answered right away, valid ones keep a placeholder until they are dispatched
+            std::vector<Response> responses;
+            std::vector<Request> requests;
+            std::vector<size_t> slots;
+            responses.reserve(size);
+            requests.reserve(size);
+            slots.reserve(size);
+
+            const bool parallel = myBatchExecutor && size >= myMinimumParallelBatchSize;
+
+            for (size_t i = 0; i < size; ++i) {
+                FaultStatus fault;
+                Request request = reader.TryGetBatchRequestView(i, fault);
+                if (fault) {
+                    responses.emplace_back(fault.GetCode(), fault.GetString(), Value());
+                } else {
+                    requests.emplace_back(std::move(request));
+                    slots.push_back(i);
+                    responses.emplace_back(Value(), Value());
+                }
+            }
+            parseTimer.Stop();
+
+            auto invoke = [&](size_t index) {
+                Request& request = requests[index];
+                responses[slots[index]] = Invoke(fmtHandler, std::move(request));
+            };
+
+            if (parallel) {
+                myBatchExecutor(requests.size(), invoke);
+            } else {
+                for (size_t i = 0; i < requests.size(); ++i) {
+                    invoke(i);
+                }
+            }
+
+            Metrics* metrics = myDispatcher.GetMetrics();
+            MetricsTimer serialiseTimer(metrics != nullptr ? &metrics->GetSerialiseTime() : nullptr);
+            WriteStatic(writer, [&](auto& w) { WriteBatch(responses, w); });
+        }
+
+        // Responses of an asynchronous batch, written by whichever call completes last
+        struct PendingBatch {
+            PendingBatch(size_t size, FormatHandler& handler, ResponseCallback callback, Metrics* metrics)
+                : remaining(1), fmtHandler(handler), onComplete(std::move(callback)), metrics(metrics) {
+                responses.reserve(size);
+            }
+
+            void Release() {
+                if (--remaining == 0) {
+                    auto writer = fmtHandler.CreateWriter();
+                    MetricsTimer serialiseTimer(metrics != nullptr ? &metrics->GetSerialiseTime() : nullptr);
+                    WriteStatic(*writer, [&](auto& w) { WriteBatch(responses, w); });
+                    serialiseTimer.Stop();
+                    onComplete(writer->GetData());
+                }
+            }
+
+            std::vector<Response> responses;
+            // one count per call still running, plus one held while they are being dispatched
+            std::atomic<size_t> remaining;
+            FormatHandler& fmtHandler;
+            ResponseCallback onComplete;
+            Metrics* metrics;
+        };
+
+        void HandleBatchAsync(Reader& reader, FormatHandler& fmtHandler, ResponseCallback onComplete, MetricsTimer& parseTimer) const {
+            const size_t size = reader.GetBatchSize();
+            auto batch = std::make_shared<PendingBatch>(size, fmtHandler, std::move(onComplete), myDispatcher.GetMetrics());
+
+            std::vector<Request> requests;
+            std::vector<size_t> slots;
+            requests.reserve(size);
+            slots.reserve(size);
+
+            for (size_t i = 0; i < size; ++i) {
+                FaultStatus fault;
+                Request request = reader.TryGetBatchRequestView(i, fault);
+                if (fault) {
+                    batch->responses.emplace_back(fault.GetCode(), fault.GetString(), Value());
+                } else {
+                    requests.emplace_back(std::move(request));
+                    slots.push_back(i);
+                    batch->responses.emplace_back(Value(), Value());
+                }
+            }
+            parseTimer.Stop();
+
+            // each call writes its own slot only, the vector itself is not touched until the last one is done
+            auto invoke = [&](size_t index) {
+                const size_t slot = slots[index];
+                Request& request = requests[index];
+                if (InvokeStatic(request, batch->responses[slot])) {
+                    return;
+                }
+                auto method = myDispatcher.GetMethodHandle(request.GetMethodName());
+                if (!method || !method.GetMethod().IsAsync()) {
+                    batch->responses[slot] = Invoke(fmtHandler, method, std::move(request));
+                    return;
+                }
+                batch->remaining += 1;
+                myDispatcher.InvokeAsync(request, [batch, slot](Response response) {
+                    batch->responses[slot] = std::move(response);
+                    batch->Release();
+                });
+            };
+
+            if (myBatchExecutor && requests.size() >= myMinimumParallelBatchSize) {
+                myBatchExecutor(requests.size(), invoke);
+            } else {
+                for (size_t i = 0; i < requests.size(); ++i) {
+                    invoke(i);
+                }
+            }
+            batch->Release();
+        }
+
+        template<typename WriterType>
+        static void WriteBatch(const std::vector<Response>& responses, WriterType& writer) {
+            bool started = false;
+            for (auto& response : responses) {
+                if (IsNotification(response)) {
+                    continue;
+                }
+                if (!started) {
+                    writer.StartDocument();
+                    writer.StartBatch();
+                    started = true;
+                }
+                response.WriteResponse(writer);
+            }
+
+            if (started) {
+                writer.EndBatch();
+                writer.EndDocument();
+            }
+        }
+
         Dispatcher myDispatcher;
-        std::vector<FormatHandler*> myFormatHandlers;
+        Snapshot<std::vector<FormatHandler*>> myFormatHandlers;
+        BatchExecutor myBatchExecutor;
+        size_t myMinimumParallelBatchSize = 16;
+        const StaticMethods* myStaticMethods = nullptr;
+        ParseLimits myParseLimits;
+        bool myHasParseLimits = false;
     };
 
 } // namespace jsonrpc
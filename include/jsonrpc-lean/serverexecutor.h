@@ -0,0 +1,301 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_SERVEREXECUTOR_H
+#define JSONRPC_LEAN_SERVEREXECUTOR_H
+
+#include "server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace jsonrpc {
+
+    // Thread pool handling requests for a Server. Each worker has its own deque: it takes its newest task
+    // first, and steals the oldest task of another worker when its own deque is empty. Requests are handled
+    // with Server::HandleRequestAsync, so a worker is free again as soon as asynchronous methods are started,
+    // and the executor is installed as the server's batch executor so the calls of a batch are stolen by idle
+    // workers too. That makes creating and destroying it a change of the server's configuration: do it while
+    // no request is being handled (see Server::SetBatchExecutor).
+    class ServerExecutor {
+    public:
+        struct Options {
+            // 0 uses one thread per hardware thread
+            size_t threadCount = 0;
+            // Requests waiting for a worker, beyond which Submit refuses more; 0 for no limit
+            size_t maximumQueueDepth = 1024;
+            // Pins worker i to CPU i (modulo the CPU count); only on Linux, ignored elsewhere
+            bool pinThreads = false;
+            // Batches with fewer calls are handled by the one worker that got them; 0 leaves the batch executor alone
+            size_t minimumParallelBatchSize = 16;
+        };
+
+        typedef Server::ResponseCallback ResponseCallback;
+
+        explicit ServerExecutor(Server& server) : ServerExecutor(server, Options()) {}
+
+        ServerExecutor(Server& server, Options options) : myServer(server), myOptions(options) {
+            size_t count = myOptions.threadCount;
+            if (count == 0) {
+                count = std::thread::hardware_concurrency();
+            }
+            if (count == 0) {
+                count = 1;
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                myQueues.emplace_back(new Queue());
+            }
+
+            // before the workers start, so they see it; see Server::SetBatchExecutor for the other threads
+            if (myOptions.minimumParallelBatchSize > 0) {
+                myServer.SetBatchExecutor([this](size_t count, const std::function<void(size_t)>& task) { ParallelFor(count, task); },
+                    myOptions.minimumParallelBatchSize);
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                myThreads.emplace_back([this, i] { Work(i); });
+                if (myOptions.pinThreads) {
+                    Pin(myThreads.back(), i);
+                }
+            }
+        }
+
+        // Finishes the tasks already queued; asynchronous methods still running complete on their own threads.
+        // Nothing may be submitted anymore, and no other thread may be handling requests on the server.
+        ~ServerExecutor() {
+            myStopping = true;
+            Wake(true);
+            for (auto& thread : myThreads) {
+                thread.join();
+            }
+
+            // only once the workers are done with the batches they were dispatching
+            if (myOptions.minimumParallelBatchSize > 0) {
+                myServer.SetBatchExecutor(nullptr);
+            }
+        }
+
+        ServerExecutor(const ServerExecutor&) = delete;
+        ServerExecutor& operator=(const ServerExecutor&) = delete;
+
+        // Queues the request; onComplete gets the response, as with Server::HandleRequestAsync. Returns false
+        // without queueing anything when maximumQueueDepth requests are already waiting, so the caller can
+        // slow down (stop reading from the connection, answer "busy", ...) instead of memory growing.
+        bool Submit(std::string aRequestData, std::string aContentType, ResponseCallback onComplete) {
+            const size_t depth = myQueuedRequests++;
+            if (myOptions.maximumQueueDepth > 0 && depth >= myOptions.maximumQueueDepth) {
+                --myQueuedRequests;
+                return false;
+            }
+
+            Push([this, aRequestData = std::move(aRequestData), aContentType = std::move(aContentType), onComplete = std::move(onComplete)] {
+                --myQueuedRequests;
+                myServer.HandleRequestAsync(aRequestData, aContentType, onComplete);
+            });
+            return true;
+        }
+
+        // Runs task(0) ... task(count - 1) on the workers and returns once all of them are done; the calling
+        // thread runs tasks meanwhile, so this may be called from a worker. The tasks must not throw.
+        void ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+            if (count == 0) {
+                return;
+            }
+
+            auto group = std::make_shared<Group>(count);
+            for (size_t i = 1; i < count; ++i) {
+                Push([group, &task, i] {
+                    task(i);
+                    group->Finish();
+                });
+            }
+
+            task(0);
+            group->Finish();
+
+            while (group->remaining > 0) {
+                if (RunOne(CurrentWorker())) {
+                    continue;
+                }
+                // nothing left to steal, the remaining tasks are running
+                std::unique_lock<std::mutex> lock(group->mutex);
+                group->done.wait(lock, [&] { return group->remaining == 0; });
+            }
+        }
+
+        size_t GetThreadCount() const { return myThreads.size(); }
+
+        // Requests submitted and not yet taken by a worker
+        size_t GetQueueDepth() const { return myQueuedRequests; }
+
+    private:
+        typedef std::function<void()> Task;
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        struct Group {
+            explicit Group(size_t count) : remaining(count) {}
+
+            void Finish() {
+                if (--remaining == 0) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.notify_all();
+                }
+            }
+
+            std::atomic<size_t> remaining;
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+
+        static const size_t NOT_A_WORKER = static_cast<size_t>(-1);
+
+        struct WorkerId {
+            const ServerExecutor* executor;
+            size_t index;
+        };
+
+        static WorkerId& CurrentWorkerId() {
+            static thread_local WorkerId current = { nullptr, NOT_A_WORKER };
+            return current;
+        }
+
+        size_t CurrentWorker() const {
+            const WorkerId& id = CurrentWorkerId();
+            return id.executor == this ? id.index : NOT_A_WORKER;
+        }
+
+        // Workers push to their own deque, where idle workers steal from; other threads spread their tasks
+        void Push(Task task) {
+            size_t index = CurrentWorker();
+            if (index == NOT_A_WORKER) {
+                index = myNextQueue++ % myQueues.size();
+            }
+
+            // counted first, so the count never drops below the tasks actually queued
+            ++myQueuedTasks;
+            Queue& queue = *myQueues[index];
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.tasks.emplace_back(std::move(task));
+            }
+            Wake(false);
+        }
+
+        bool RunOne(size_t self) {
+            Task task;
+            if (self != NOT_A_WORKER) {
+                Queue& own = *myQueues[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty()) {
+                    task = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                }
+            }
+
+            const size_t count = myQueues.size();
+            for (size_t i = 1; !task && i <= count; ++i) {
+                const size_t victim = self == NOT_A_WORKER ? i - 1 : (self + i) % count;
+                if (victim == self) {
+                    continue;
+                }
+                Queue& queue = *myQueues[victim];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.tasks.empty()) {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+            }
+
+            if (!task) {
+                return false;
+            }
+            --myQueuedTasks;
+            task();
+            return true;
+        }
+
+        void Work(size_t index) {
+            CurrentWorkerId() = { this, index };
+            for (;;) {
+                if (RunOne(index)) {
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(mySleepMutex);
+                mySleep.wait(lock, [&] { return myStopping || myQueuedTasks > 0; });
+                if (myStopping && myQueuedTasks == 0) {
+                    return;
+                }
+            }
+        }
+
+        void Wake(bool all) {
+            // taking the mutex orders this with a worker about to sleep, so the wake up can't be missed
+            { std::lock_guard<std::mutex> lock(mySleepMutex); }
+            if (all) {
+                mySleep.notify_all();
+            } else {
+                mySleep.notify_one();
+            }
+        }
+
+        static void Pin(std::thread& thread, size_t index) {
+#if defined(__linux__)
+            const size_t cpuCount = std::thread::hardware_concurrency();
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpuCount > 0 ? index % cpuCount : 0, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+            (void)thread;
+            (void)index;
+#endif
+        }
+
+        Server& myServer;
+        Options myOptions;
+        std::vector<std::unique_ptr<Queue>> myQueues;
+        std::vector<std::thread> myThreads;
+        std::atomic<size_t> myNextQueue{ 0 };
+        std::atomic<size_t> myQueuedTasks{ 0 };
+        std::atomic<size_t> myQueuedRequests{ 0 };
+        std::atomic<bool> myStopping{ false };
+        std::mutex mySleepMutex;
+        std::condition_variable mySleep;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_SERVEREXECUTOR_H
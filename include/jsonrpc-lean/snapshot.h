@@ -0,0 +1,67 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_SNAPSHOT_H
+#define JSONRPC_LEAN_SNAPSHOT_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace jsonrpc {
+
+    // Read-copy-update holder for data read on every request but rarely changed. Readers get the current
+    // version with one atomic load and never wait; Update modifies a copy and publishes it atomically.
+    // Replaced versions may still be in use by readers, so they are only freed with the Snapshot.
+    template<typename T>
+    class Snapshot {
+    public:
+        Snapshot() : myCurrent(new T()) {}
+
+        ~Snapshot() {
+            delete myCurrent.load(std::memory_order_relaxed);
+        }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        // Stays valid until the Snapshot is destroyed, updates published meanwhile are not seen through it
+        const T& Get() const { return *myCurrent.load(std::memory_order_acquire); }
+
+        // Updates are serialised with each other only, readers go on using the previous version meanwhile
+        template<typename UpdateType>
+        void Update(UpdateType update) {
+            std::lock_guard<std::mutex> lock(myUpdateMutex);
+            std::unique_ptr<T> next(new T(*myCurrent.load(std::memory_order_relaxed)));
+            update(*next);
+            myRetired.emplace_back(myCurrent.exchange(next.release(), std::memory_order_acq_rel));
+        }
+
+        // In place, for when no other thread can be reading
+        T& GetMutable() { return *myCurrent.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<T*> myCurrent;
+        std::mutex myUpdateMutex;
+        std::vector<std::unique_ptr<T>> myRetired;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_SNAPSHOT_H
@@ -0,0 +1,264 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_STATICDISPATCHER_H
+#define JSONRPC_LEAN_STATICDISPATCHER_H
+
+#include "dispatcher.h"
+#include "fault.h"
+#include "integer_seq.h"
+#include "request.h"
+#include "response.h"
+#include "value.h"
+#include "valueview.h"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// StaticMethod for a function, e.g. JSONRPC_LEAN_STATIC_METHOD(ADD, &Add) with constexpr char ADD[] = "add"
+#define JSONRPC_LEAN_STATIC_METHOD(name, function) ::jsonrpc::StaticMethod<name, decltype(function), function>
+
+namespace jsonrpc {
+
+    // A method known at compile time: name must be a constexpr char array (string literals can't be template
+    // arguments before C++20), and function a function or static member function. Its parameters are read
+    // like those of Dispatcher::AddMethod, positionally.
+    template<const char* name, typename FunctionType, FunctionType function>
+    struct StaticMethod;
+
+    template<const char* name, typename ReturnType, typename... ParameterTypes, ReturnType(*function)(ParameterTypes...)>
+    struct StaticMethod<name, ReturnType(*)(ParameterTypes...), function> {
+        static constexpr const char* NAME = name;
+
+        static Value Call(const ValueView& params, FaultStatus& fault) {
+            if ((!params.IsArray() && !params.IsUndefined()) || params.Size() != sizeof...(ParameterTypes)) {
+                fault = InvalidParametersFault();
+                return Value();
+            }
+            return Call(params, fault, redi::index_sequence_for<ParameterTypes...>{}, std::is_void<ReturnType>());
+        }
+
+    private:
+        template<std::size_t... index>
+        static Value Call(const ValueView& params, FaultStatus& fault, redi::index_sequence<index...>, std::false_type) {
+            if (!Matches({ true, ViewParameter<typename std::decay<ParameterTypes>::type>::Matches(params[index])... })) {
+                fault = InvalidParametersFault();
+                return Value();
+            }
+            return function(ViewParameter<typename std::decay<ParameterTypes>::type>::Get(params[index])...);
+        }
+
+        template<std::size_t... index>
+        static Value Call(const ValueView& params, FaultStatus& fault, redi::index_sequence<index...>, std::true_type) {
+            if (!Matches({ true, ViewParameter<typename std::decay<ParameterTypes>::type>::Matches(params[index])... })) {
+                fault = InvalidParametersFault();
+                return Value();
+            }
+            function(ViewParameter<typename std::decay<ParameterTypes>::type>::Get(params[index])...);
+            return Value();
+        }
+
+        static bool Matches(std::initializer_list<bool> values) {
+            for (bool value : values) {
+                if (!value) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    template<const char* name, typename ReturnType, typename... ParameterTypes, ReturnType(*function)(ParameterTypes...)>
+    constexpr const char* StaticMethod<name, ReturnType(*)(ParameterTypes...), function>::NAME;
+
+    // What Server::SetStaticMethods takes, whatever the methods are
+    class StaticMethods {
+    public:
+        virtual ~StaticMethods() {}
+
+        // False, leaving request as it was, if it isn't for one of these methods
+        virtual bool TryInvoke(Request& request, Response& response) const = 0;
+    };
+
+    namespace detail {
+
+        constexpr size_t StaticLength(const char* name) {
+            size_t size = 0;
+            while (name[size] != '\0') {
+                ++size;
+            }
+            return size;
+        }
+
+        // FNV-1a, seeded so that a seed giving every name a slot of its own can be searched for
+        constexpr uint32_t StaticHash(const char* name, size_t size, uint32_t seed) {
+            uint32_t hash = 2166136261u ^ seed;
+            for (size_t i = 0; i < size; ++i) {
+                hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619u;
+            }
+            return hash ^ (hash >> 16);
+        }
+
+        // Slots of the names (plus one, 0 when empty) for the first seed under which none of them collide
+        template<size_t count, size_t tableSize>
+        struct StaticTable {
+            uint32_t seed = 0;
+            uint16_t slots[tableSize] = {};
+        };
+
+        template<size_t count, size_t tableSize>
+        constexpr StaticTable<count, tableSize> MakeStaticTable(const char* const (&names)[count + 1]) {
+            StaticTable<count, tableSize> table;
+            for (uint32_t seed = 0; seed < 100000; ++seed) {
+                bool collides = false;
+                for (size_t i = 0; i < tableSize; ++i) {
+                    table.slots[i] = 0;
+                }
+                for (size_t i = 0; i < count && !collides; ++i) {
+                    const size_t slot = StaticHash(names[i], StaticLength(names[i]), seed) & (tableSize - 1);
+                    collides = table.slots[slot] != 0;
+                    table.slots[slot] = static_cast<uint16_t>(i + 1);
+                }
+                if (!collides) {
+                    table.seed = seed;
+                    return table;
+                }
+            }
+            throw std::logic_error("no perfect hash for the names, are two of them the same?");
+        }
+
+        // About half the square of the names, so one of the first few seeds is enough
+        constexpr size_t StaticTableSize(size_t count) {
+            size_t size = 2;
+            while (size < count * count / 2) {
+                size *= 2;
+            }
+            return size;
+        }
+
+    } // namespace detail
+
+    // Dispatches the methods it is instantiated with without looking anything up at run time beyond a perfect
+    // hash of the names, computed while compiling, and calls them directly (so they can be inlined), without
+    // std::function or allocations. Requests for other methods go to the dynamic dispatcher given.
+    // Metrics and response caching are only for the dispatcher's own methods.
+    template<typename... MethodTypes>
+    class StaticDispatcher final : public StaticMethods {
+    public:
+        static const size_t NOT_FOUND = static_cast<size_t>(-1);
+        static const size_t METHOD_COUNT = sizeof...(MethodTypes);
+
+        static_assert(METHOD_COUNT < 65535, "too many static methods");
+
+        explicit StaticDispatcher(const Dispatcher& fallback) : myFallback(fallback) {}
+
+        // Index of the method in MethodTypes, NOT_FOUND if it isn't one of them
+        static size_t Find(const char* name, size_t size) {
+            const size_t slot = detail::StaticHash(name, size, TABLE.seed) & (TABLE_SIZE - 1);
+            const size_t index = static_cast<size_t>(TABLE.slots[slot]) - 1;
+            if (index == NOT_FOUND || LENGTHS[index] != size || memcmp(NAMES[index], name, size) != 0) {
+                return NOT_FOUND;
+            }
+            return index;
+        }
+
+        static size_t Find(const std::string& name) { return Find(name.data(), name.size()); }
+
+        Response Invoke(const Request& request) const {
+            const size_t index = Find(request.GetMethodName());
+            if (index == NOT_FOUND) {
+                return myFallback.Invoke(request);
+            }
+            return Call(index, request.GetParametersView(), Value(request.GetId()));
+        }
+
+        Response Invoke(Request&& request) const {
+            const size_t index = Find(request.GetMethodName());
+            if (index == NOT_FOUND) {
+                return myFallback.Invoke(std::move(request));
+            }
+            return Call(index, request.TakeParametersView(), request.TakeId());
+        }
+
+        bool TryInvoke(Request& request, Response& response) const override {
+            const size_t index = Find(request.GetMethodName());
+            if (index == NOT_FOUND) {
+                return false;
+            }
+            response = Call(index, request.TakeParametersView(), request.TakeId());
+            return true;
+        }
+
+    private:
+        typedef Value(*Caller)(const ValueView&, FaultStatus&);
+
+        static constexpr size_t TABLE_SIZE = detail::StaticTableSize(METHOD_COUNT);
+        // one more, so that there is always an element
+        static constexpr const char* NAMES[METHOD_COUNT + 1] = { MethodTypes::NAME..., "" };
+        static constexpr size_t LENGTHS[METHOD_COUNT + 1] = { detail::StaticLength(MethodTypes::NAME)..., 0 };
+        static constexpr detail::StaticTable<METHOD_COUNT, TABLE_SIZE> TABLE = detail::MakeStaticTable<METHOD_COUNT, TABLE_SIZE>(NAMES);
+        static constexpr Caller CALLERS[METHOD_COUNT + 1] = { &MethodTypes::Call..., nullptr };
+
+        // Faults are answered as Dispatcher::Invoke answers them
+        static Response Call(size_t index, const ValueView& params, Value id) {
+            try {
+                FaultStatus fault;
+                Value result = CALLERS[index](params, fault);
+                if (fault) {
+                    return Response(fault.GetCode(), fault.GetString(), std::move(id));
+                }
+                return Response(std::move(result), std::move(id));
+            }
+            catch (const Fault& fault) {
+                return Response(fault.GetCode(), fault.GetString(), std::move(id));
+            }
+            catch (const std::out_of_range&) {
+                InvalidParametersFault fault;
+                return Response(fault.GetCode(), fault.GetString(), std::move(id));
+            }
+            catch (const std::exception& ex) {
+                return Response(0, ex.what(), std::move(id));
+            }
+            catch (...) {
+                return Response(0, "unknown error", std::move(id));
+            }
+        }
+
+        const Dispatcher& myFallback;
+    };
+
+    template<typename... MethodTypes>
+    constexpr size_t StaticDispatcher<MethodTypes...>::TABLE_SIZE;
+    template<typename... MethodTypes>
+    constexpr const char* StaticDispatcher<MethodTypes...>::NAMES[];
+    template<typename... MethodTypes>
+    constexpr size_t StaticDispatcher<MethodTypes...>::LENGTHS[];
+    template<typename... MethodTypes>
+    constexpr detail::StaticTable<StaticDispatcher<MethodTypes...>::METHOD_COUNT, StaticDispatcher<MethodTypes...>::TABLE_SIZE> StaticDispatcher<MethodTypes...>::TABLE;
+    template<typename... MethodTypes>
+    constexpr typename StaticDispatcher<MethodTypes...>::Caller StaticDispatcher<MethodTypes...>::CALLERS[];
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_STATICDISPATCHER_H
@@ -0,0 +1,175 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_TASK_H
+#define JSONRPC_LEAN_TASK_H
+
+#include "compat.h"
+
+#ifdef JSONRPC_LEAN_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace jsonrpc {
+
+    template<typename T>
+    class Task;
+
+    namespace detail {
+
+        class TaskPromiseBase {
+        public:
+            // Once done, the coroutine awaiting the task carries on, without growing the stack
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+
+                template<typename PromiseType>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> task) noexcept {
+                    return task.promise().myContinuation;
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+
+            void unhandled_exception() { myException = std::current_exception(); }
+
+            void SetContinuation(std::coroutine_handle<> continuation) { myContinuation = continuation; }
+
+        protected:
+            void RethrowIfFailed() const {
+                if (myException) {
+                    std::rethrow_exception(myException);
+                }
+            }
+
+        private:
+            std::coroutine_handle<> myContinuation = std::noop_coroutine();
+            std::exception_ptr myException;
+        };
+
+        template<typename T>
+        class TaskPromise : public TaskPromiseBase {
+        public:
+            Task<T> get_return_object() noexcept;
+
+            template<typename ValueType>
+            void return_value(ValueType&& value) { myValue.emplace(std::forward<ValueType>(value)); }
+
+            T TakeResult() {
+                RethrowIfFailed();
+                return std::move(*myValue);
+            }
+
+        private:
+            std::optional<T> myValue;
+        };
+
+        template<>
+        class TaskPromise<void> : public TaskPromiseBase {
+        public:
+            Task<void> get_return_object() noexcept;
+
+            void return_void() const noexcept {}
+
+            void TakeResult() const { RethrowIfFailed(); }
+        };
+
+        // Runs as soon as it is called and frees itself when done, for the coroutine that starts tasks from
+        // code that isn't a coroutine (see Dispatcher::AddMethod)
+        struct DetachedTask {
+            struct promise_type {
+                DetachedTask get_return_object() const noexcept { return {}; }
+                std::suspend_never initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept { std::terminate(); }
+            };
+        };
+
+    } // namespace detail
+
+    // Result of a coroutine, e.g. a method registered with Dispatcher::AddMethod. Lazy: the coroutine only
+    // starts once the task is awaited, and the awaiting coroutine resumes when it is done, with its result or
+    // the exception it threw. Move only, it owns the coroutine's frame.
+    template<typename T>
+    class Task {
+    public:
+        typedef detail::TaskPromise<T> promise_type;
+
+        Task(Task&& other) noexcept : myCoroutine(std::exchange(other.myCoroutine, nullptr)) {}
+
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                Destroy();
+                myCoroutine = std::exchange(other.myCoroutine, nullptr);
+            }
+            return *this;
+        }
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task() { Destroy(); }
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            myCoroutine.promise().SetContinuation(awaiting);
+            return myCoroutine;
+        }
+
+        T await_resume() { return myCoroutine.promise().TakeResult(); }
+
+    private:
+        explicit Task(std::coroutine_handle<promise_type> coroutine) noexcept : myCoroutine(coroutine) {}
+
+        void Destroy() {
+            if (myCoroutine) {
+                myCoroutine.destroy();
+            }
+        }
+
+        std::coroutine_handle<promise_type> myCoroutine;
+
+        friend promise_type;
+    };
+
+    namespace detail {
+
+        template<typename T>
+        Task<T> TaskPromise<T>::get_return_object() noexcept {
+            return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+            return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+        }
+
+    } // namespace detail
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_HAS_COROUTINES
+
+#endif // JSONRPC_LEAN_TASK_H
@@ -20,19 +20,32 @@
 #ifndef JSONRPC_LEAN_UTIL_H
 #define JSONRPC_LEAN_UTIL_H
 
+#include "compat.h"
+
 #include <stdint.h>
+#include <algorithm>
 #include <string>
 #include <cassert>
+#include <cctype>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <sstream>
-#include <iomanip>
+
+#if defined(JSONRPC_LEAN_HAS_X86_SIMD)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(JSONRPC_LEAN_HAS_NEON)
+#include <arm_neon.h>
+#endif
 
 struct tm;
 
 namespace {
 
-    const char DATE_TIME_FORMAT[] = "%Y%m%dT%T";
-
     constexpr char BASE_64_ALPHABET[64 + 1] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
     constexpr int8_t BASE_64_LUT[256] = {
@@ -76,89 +89,610 @@ namespace {
 namespace jsonrpc {
     namespace util {
 
+        // Room FormatDouble and FormatInt32 need
+        const size_t MAXIMUM_NUMBER_SIZE = 32;
+
+        // Room FormatIso8601DateTime needs; years before 0 or after 9999 take more than 4 digits
+        const size_t MAXIMUM_DATE_TIME_SIZE = 32;
+
+        // Writes the shortest text that reads back as exactly value, in the "C" locale whatever the current one
+        // is, and returns its size (no '\0' is added). value must be finite.
+        inline size_t FormatDouble(double value, char* str) {
+#if defined(JSONRPC_LEAN_HAS_TO_CHARS)
+            return static_cast<size_t>(std::to_chars(str, str + MAXIMUM_NUMBER_SIZE, value).ptr - str);
+#else
+            int size = 0;
+            for (int precision = 15; precision <= 17; ++precision) {
+                size = snprintf(str, MAXIMUM_NUMBER_SIZE, "%.*g", precision, value);
+                if (strtod(str, nullptr) == value) {
+                    break;
+                }
+            }
+            const char point = *localeconv()->decimal_point;
+            if (point != '.') {
+                std::replace(str, str + size, point, '.');
+            }
+            return static_cast<size_t>(size);
+#endif
+        }
+
+        inline size_t FormatInt32(int32_t value, char* str) {
+            uint32_t magnitude = value < 0 ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+            char digits[10];
+            size_t count = 0;
+            do {
+                digits[count++] = static_cast<char>('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude != 0);
+
+            size_t size = 0;
+            if (value < 0) {
+                str[size++] = '-';
+            }
+            while (count != 0) {
+                str[size++] = digits[--count];
+            }
+            return size;
+        }
+
+        // True if all of str (but for surrounding white space) is a number, as strtod reads them
+        inline bool ParseDouble(const char* str, size_t size, double& value) {
+            const char* end = str + size;
+            while (end != str && std::isspace(static_cast<unsigned char>(end[-1]))) {
+                --end;
+            }
+#if defined(JSONRPC_LEAN_HAS_TO_CHARS)
+            // from_chars takes neither white space nor '+' in front, and always reads in the "C" locale
+            const char* begin = str;
+            while (begin != end && std::isspace(static_cast<unsigned char>(*begin))) {
+                ++begin;
+            }
+            if (end - begin > 1 && begin[0] == '+' && begin[1] != '-') {
+                ++begin;
+            }
+            const auto result = std::from_chars(begin, end, value);
+            if (result.ec == std::errc() && result.ptr == end) {
+                return true;
+            }
+            // hexadecimal, out of range...
+#endif
+            // strtod wants the text '\0' terminated
+            char buffer[64];
+            std::string copy;
+            const size_t length = static_cast<size_t>(end - str);
+            const char* text = buffer;
+            if (length < sizeof(buffer)) {
+                memcpy(buffer, str, length);
+                buffer[length] = '\0';
+            } else {
+                copy.assign(str, length);
+                text = copy.c_str();
+            }
+
+            char* parsed;
+            value = std::strtod(text, &parsed);
+            return parsed != text && parsed == text + length;
+        }
+
+        namespace detail {
+            inline char* PutDigits(char* str, unsigned value, int count) {
+                for (int i = count - 1; i >= 0; --i) {
+                    str[i] = static_cast<char>('0' + value % 10);
+                    value /= 10;
+                }
+                return str + count;
+            }
+
+            inline bool GetDigits(const char* str, int count, int& value) {
+                value = 0;
+                for (int i = 0; i < count; ++i) {
+                    if (str[i] < '0' || str[i] > '9') {
+                        return false;
+                    }
+                    value = value * 10 + (str[i] - '0');
+                }
+                return true;
+            }
+        } // namespace detail
+
+        // Writes dt as YYYYMMDDTHH:MM:SS and returns the size (no '\0' is added)
+        inline size_t FormatIso8601DateTime(const tm& dt, char* str) {
+            char* out = str;
+            const long long year = dt.tm_year + 1900LL;
+            if (year >= 0 && year <= 9999) {
+                out = detail::PutDigits(out, static_cast<unsigned>(year), 4);
+            } else {
+                out += FormatInt32(static_cast<int32_t>(year), out);
+            }
+            out = detail::PutDigits(out, static_cast<unsigned>(dt.tm_mon + 1), 2);
+            out = detail::PutDigits(out, static_cast<unsigned>(dt.tm_mday), 2);
+            *out++ = 'T';
+            out = detail::PutDigits(out, static_cast<unsigned>(dt.tm_hour), 2);
+            *out++ = ':';
+            out = detail::PutDigits(out, static_cast<unsigned>(dt.tm_min), 2);
+            *out++ = ':';
+            out = detail::PutDigits(out, static_cast<unsigned>(dt.tm_sec), 2);
+            return static_cast<size_t>(out - str);
+        }
+
         inline std::string FormatIso8601DateTime(const tm& dt) {
-            char str[128];
-            return std::string(str, strftime(str, sizeof(str), DATE_TIME_FORMAT, &dt));
+            char str[MAXIMUM_DATE_TIME_SIZE];
+            return std::string(str, FormatIso8601DateTime(dt, str));
         }
 
-        inline bool ParseIso8601DateTime(const char* text, tm& dt) {
-            if (!text) {
+        // Reads the YYYYMMDDTHH:MM:SS that FormatIso8601DateTime writes; anything after it is ignored
+        inline bool ParseIso8601DateTime(const char* text, size_t size, tm& dt) {
+            memset(&dt, 0, sizeof(dt));
+            // 'T' or 't', as std::get_time matched it
+            if (!text || size < 17 || (text[8] | 0x20) != 't' || text[11] != ':' || text[14] != ':') {
                 return false;
             }
-            memset(&dt, 0, sizeof(dt));
-            std::istringstream ss(text);
-            ss >> std::get_time(&dt, DATE_TIME_FORMAT);
 
-            if (ss.fail()) {
+            int year, month, day, hour, minute, second;
+            if (!detail::GetDigits(text, 4, year) || !detail::GetDigits(text + 4, 2, month) || !detail::GetDigits(text + 6, 2, day) ||
+                !detail::GetDigits(text + 9, 2, hour) || !detail::GetDigits(text + 12, 2, minute) || !detail::GetDigits(text + 15, 2, second)) {
                 return false;
             }
+            if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+                return false;
+            }
+
+            dt.tm_year = year - 1900;
+            dt.tm_mon = month - 1;
+            dt.tm_mday = day;
+            dt.tm_hour = hour;
+            dt.tm_min = minute;
+            dt.tm_sec = second;
             dt.tm_isdst = -1;
             return true;
         }
 
-        inline std::string Base64Encode(const std::string& data); // forward declaration
+        inline bool ParseIso8601DateTime(const char* text, tm& dt) {
+            return ParseIso8601DateTime(text, text ? strlen(text) : 0, dt);
+        }
 
-        inline std::string Base64Encode(const char* data, size_t size) {
-            const size_t lineLength = 76;
-            static_assert(lineLength % 4 == 0, "invalid line length");
+        // Base64 is written in lines of this many characters, separated by "\r\n"
+        const size_t BASE_64_LINE_LENGTH = 76;
+        static_assert(BASE_64_LINE_LENGTH % 4 == 0, "invalid line length");
 
-            if (size == 0) {
-                return{};
+        namespace detail {
+
+            // Encoders convert as many whole blocks of data as they can (at most size bytes) and return how many
+            // bytes they consumed, a multiple of 3; they may read up to readable bytes. Decoders convert blocks of
+            // characters, skipping the line breaks between groups, up to the first group with anything else
+            // outside the alphabet in it (padding, a line break in a group); they return how many characters they
+            // consumed and set written to the number of bytes they wrote.
+            struct Base64Kernels {
+                size_t(*encode)(const uint8_t* data, size_t size, size_t readable, char* str);
+                size_t(*decode)(const char* str, size_t size, uint8_t* data, size_t& written);
+            };
+
+            inline size_t Base64EncodeScalar(const uint8_t*, size_t, size_t, char*) { return 0; }
+            inline size_t Base64DecodeScalar(const char*, size_t, uint8_t*, size_t& written) { return written = 0; }
+
+            // The "\r\n" Base64Encode puts between lines
+            inline bool Base64IsLineBreak(const char* str, size_t size) {
+                return size >= 2 && str[0] == '\r' && str[1] == '\n';
+            }
+
+#if defined(JSONRPC_LEAN_HAS_X86_SIMD)
+#if defined(__GNUC__)
+#define JSONRPC_LEAN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define JSONRPC_LEAN_TARGET(isa)
+#endif
+
+            // 12 bytes, from the first 12 of bytes, to 16 characters (Wojciech Muła's base64 with pshufb)
+            JSONRPC_LEAN_TARGET("ssse3") inline __m128i Base64EncodeBlock(__m128i bytes) {
+                // each 32 bit lane gets the 3 bytes of one group, as [1 0 2 1]
+                const __m128i groups = _mm_shuffle_epi8(bytes, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+                const __m128i high = _mm_mulhi_epu16(_mm_and_si128(groups, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+                const __m128i low = _mm_mullo_epi16(_mm_and_si128(groups, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+                const __m128i indices = _mm_or_si128(high, low);
+
+                // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12: which offset to add to the index
+                __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+                range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+                const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+                return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range));
+            }
+
+            JSONRPC_LEAN_TARGET("avx2") inline __m256i Base64EncodeBlock(__m256i bytes) {
+                const __m256i groups = _mm256_shuffle_epi8(bytes, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+                const __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(groups, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+                const __m256i low = _mm256_mullo_epi16(_mm256_and_si256(groups, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+                const __m256i indices = _mm256_or_si256(high, low);
+
+                __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+                range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+                const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+                return _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+            }
+
+            // 16 characters to their 6 bit values; all of valid is set if they are all in the alphabet
+            JSONRPC_LEAN_TARGET("ssse3") inline __m128i Base64DecodeValues(__m128i chars, __m128i& valid) {
+                const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), chars));
+                const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), chars));
+                const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), chars));
+                const __m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+                const __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+                valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+
+                __m128i offsets = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+                offsets = _mm_or_si128(offsets, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+                offsets = _mm_or_si128(offsets, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+                offsets = _mm_or_si128(offsets, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+                offsets = _mm_or_si128(offsets, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+                return _mm_add_epi8(chars, offsets);
+            }
+
+            JSONRPC_LEAN_TARGET("avx2") inline __m256i Base64DecodeValues(__m256i chars, __m256i& valid) {
+                const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), chars));
+                const __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), chars));
+                const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+                const __m256i plus = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('+'));
+                const __m256i slash = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('/'));
+                valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+
+                __m256i offsets = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+                offsets = _mm256_or_si256(offsets, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+                offsets = _mm256_or_si256(offsets, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+                offsets = _mm256_or_si256(offsets, _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')));
+                offsets = _mm256_or_si256(offsets, _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')));
+                return _mm256_add_epi8(chars, offsets);
+            }
+
+            // Packs the 4 values of each 32 bit lane into its 3 bytes, in the first 12 bytes of each 128 bit lane
+            JSONRPC_LEAN_TARGET("ssse3") inline __m128i Base64DecodePack(__m128i values) {
+                const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+                const __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+                return _mm_shuffle_epi8(groups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            }
+
+            JSONRPC_LEAN_TARGET("avx2") inline __m256i Base64DecodePack(__m256i values) {
+                const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+                const __m256i groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+                return _mm256_shuffle_epi8(groups, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            }
+
+            // Number of characters before the first one outside the alphabet, given the mask of those that aren't
+            inline unsigned Base64ValidPrefix(uint32_t validMask) {
+#if defined(__GNUC__)
+                return static_cast<unsigned>(__builtin_ctz(~validMask));
+#else
+                unsigned long index;
+                _BitScanForward(&index, ~validMask);
+                return static_cast<unsigned>(index);
+#endif
+            }
+
+            JSONRPC_LEAN_TARGET("ssse3") inline size_t Base64EncodeSsse3(const uint8_t* data, size_t size, size_t readable, char* str) {
+                size_t in = 0;
+                for (; in + 12 <= size && in + 16 <= readable; in += 12, str += 16) {
+                    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + in));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(str), Base64EncodeBlock(bytes));
+                }
+                return in;
             }
 
+            JSONRPC_LEAN_TARGET("avx2") inline size_t Base64EncodeAvx2(const uint8_t* data, size_t size, size_t readable, char* str) {
+                size_t in = 0;
+                for (; in + 24 <= size && in + 28 <= readable; in += 24, str += 32) {
+                    const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + in));
+                    const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + in + 12));
+                    const __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(first), second, 1);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(str), Base64EncodeBlock(bytes));
+                }
+                return in + Base64EncodeSsse3(data + in, size - in, readable - in, str);
+            }
+
+            JSONRPC_LEAN_TARGET("ssse3") inline size_t Base64DecodeSsse3(const char* str, size_t size, uint8_t* data, size_t& written) {
+                size_t in = 0;
+                written = 0;
+                while (in + 16 <= size) {
+                    __m128i valid;
+                    const __m128i values = Base64DecodeValues(_mm_loadu_si128(reinterpret_cast<const __m128i*>(str + in)), valid);
+                    const uint32_t validMask = static_cast<uint32_t>(_mm_movemask_epi8(valid));
+
+                    // the last 4 bytes are garbage and may be past the end of data
+                    alignas(16) uint8_t bytes[16];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(bytes), Base64DecodePack(values));
+                    if (validMask == 0xffff) {
+                        memcpy(data + written, bytes, 12);
+                        in += 16;
+                        written += 12;
+                        continue;
+                    }
+
+                    // the groups before the first character outside the alphabet are still taken
+                    const size_t prefix = Base64ValidPrefix(validMask);
+                    const size_t groups = prefix / 4;
+                    memcpy(data + written, bytes, groups * 3);
+                    in += groups * 4;
+                    written += groups * 3;
+                    if (prefix % 4 != 0 || !Base64IsLineBreak(str + in, size - in)) {
+                        return in;
+                    }
+                    in += 2;
+                }
+                return in;
+            }
+
+            JSONRPC_LEAN_TARGET("avx2") inline size_t Base64DecodeAvx2(const char* str, size_t size, uint8_t* data, size_t& written) {
+                size_t in = 0;
+                written = 0;
+                while (in + 32 <= size) {
+                    __m256i valid;
+                    const __m256i values = Base64DecodeValues(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + in)), valid);
+                    const uint32_t validMask = static_cast<uint32_t>(_mm256_movemask_epi8(valid));
+
+                    // 4 groups in the first 12 bytes of each 128 bit lane
+                    alignas(32) uint8_t bytes[32];
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(bytes), Base64DecodePack(values));
+                    if (validMask == 0xffffffff) {
+                        memcpy(data + written, bytes, 12);
+                        memcpy(data + written + 12, bytes + 16, 12);
+                        in += 32;
+                        written += 24;
+                        continue;
+                    }
+
+                    const size_t prefix = Base64ValidPrefix(validMask);
+                    const size_t groups = prefix / 4;
+                    memcpy(data + written, bytes, (groups < 4 ? groups : 4) * 3);
+                    if (groups > 4) {
+                        memcpy(data + written + 12, bytes + 16, (groups - 4) * 3);
+                    }
+                    in += groups * 4;
+                    written += groups * 3;
+                    if (prefix % 4 != 0 || !Base64IsLineBreak(str + in, size - in)) {
+                        return in;
+                    }
+                    in += 2;
+                }
+
+                size_t tail;
+                in += Base64DecodeSsse3(str + in, size - in, data + written, tail);
+                written += tail;
+                return in;
+            }
+
+#undef JSONRPC_LEAN_TARGET
+
+            inline Base64Kernels SelectBase64Kernels() {
+#if defined(__GNUC__)
+                __builtin_cpu_init();
+                const bool ssse3 = __builtin_cpu_supports("ssse3");
+                const bool avx2 = __builtin_cpu_supports("avx2");
+#else
+                int info[4];
+                __cpuid(info, 0);
+                const int leaves = info[0];
+                __cpuid(info, 1);
+                const bool ssse3 = (info[2] & (1 << 9)) != 0;
+                // the OS must also save the ymm registers
+                const bool avxEnabled = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+                bool avx2 = false;
+                if (leaves >= 7 && avxEnabled) {
+                    __cpuidex(info, 7, 0);
+                    avx2 = (info[1] & (1 << 5)) != 0;
+                }
+#endif
+                if (avx2) {
+                    return{ Base64EncodeAvx2, Base64DecodeAvx2 };
+                }
+                if (ssse3) {
+                    return{ Base64EncodeSsse3, Base64DecodeSsse3 };
+                }
+                return{ Base64EncodeScalar, Base64DecodeScalar };
+            }
+
+#elif defined(JSONRPC_LEAN_HAS_NEON)
+            inline size_t Base64EncodeNeon(const uint8_t* data, size_t size, size_t, char* str) {
+                const uint8_t* alphabet = reinterpret_cast<const uint8_t*>(BASE_64_ALPHABET);
+                uint8x16x4_t table;
+                table.val[0] = vld1q_u8(alphabet);
+                table.val[1] = vld1q_u8(alphabet + 16);
+                table.val[2] = vld1q_u8(alphabet + 32);
+                table.val[3] = vld1q_u8(alphabet + 48);
+                const uint8x16_t mask = vdupq_n_u8(0x3f);
+
+                size_t in = 0;
+                for (; in + 48 <= size; in += 48, str += 64) {
+                    // deinterleaved: val[i] has byte i of each of the 16 groups
+                    const uint8x16x3_t bytes = vld3q_u8(data + in);
+                    uint8x16x4_t chars;
+                    chars.val[0] = vqtbl4q_u8(table, vshrq_n_u8(bytes.val[0], 2));
+                    chars.val[1] = vqtbl4q_u8(table, vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[0], 4), vshrq_n_u8(bytes.val[1], 4)), mask));
+                    chars.val[2] = vqtbl4q_u8(table, vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[1], 2), vshrq_n_u8(bytes.val[2], 6)), mask));
+                    chars.val[3] = vqtbl4q_u8(table, vandq_u8(bytes.val[2], mask));
+                    vst4q_u8(reinterpret_cast<uint8_t*>(str), chars);
+                }
+                return in;
+            }
+
+            // 16 characters to their 6 bit values; all of valid is set if they are all in the alphabet
+            inline uint8x16_t Base64DecodeValues(uint8x16_t chars, uint8x16_t& valid) {
+                const uint8x16_t upper = vandq_u8(vcgeq_u8(chars, vdupq_n_u8('A')), vcleq_u8(chars, vdupq_n_u8('Z')));
+                const uint8x16_t lower = vandq_u8(vcgeq_u8(chars, vdupq_n_u8('a')), vcleq_u8(chars, vdupq_n_u8('z')));
+                const uint8x16_t digit = vandq_u8(vcgeq_u8(chars, vdupq_n_u8('0')), vcleq_u8(chars, vdupq_n_u8('9')));
+                const uint8x16_t plus = vceqq_u8(chars, vdupq_n_u8('+'));
+                const uint8x16_t slash = vceqq_u8(chars, vdupq_n_u8('/'));
+                valid = vandq_u8(valid, vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, vorrq_u8(plus, slash))));
+
+                uint8x16_t offsets = vandq_u8(upper, vdupq_n_u8(static_cast<uint8_t>(-'A')));
+                offsets = vorrq_u8(offsets, vandq_u8(lower, vdupq_n_u8(static_cast<uint8_t>(26 - 'a'))));
+                offsets = vorrq_u8(offsets, vandq_u8(digit, vdupq_n_u8(52 - '0')));
+                offsets = vorrq_u8(offsets, vandq_u8(plus, vdupq_n_u8(62 - '+')));
+                offsets = vorrq_u8(offsets, vandq_u8(slash, vdupq_n_u8(63 - '/')));
+                return vaddq_u8(chars, offsets);
+            }
+
+            inline size_t Base64DecodeNeon(const char* str, size_t size, uint8_t* data, size_t& written) {
+                size_t in = 0;
+                written = 0;
+                while (in + 64 <= size) {
+                    // deinterleaved: val[i] has character i of each of the 16 groups
+                    const uint8x16x4_t chars = vld4q_u8(reinterpret_cast<const uint8_t*>(str + in));
+                    uint8x16_t valid = vdupq_n_u8(0xff);
+                    const uint8x16_t value0 = Base64DecodeValues(chars.val[0], valid);
+                    const uint8x16_t value1 = Base64DecodeValues(chars.val[1], valid);
+                    const uint8x16_t value2 = Base64DecodeValues(chars.val[2], valid);
+                    const uint8x16_t value3 = Base64DecodeValues(chars.val[3], valid);
+
+                    uint8x16x3_t bytes;
+                    bytes.val[0] = vorrq_u8(vshlq_n_u8(value0, 2), vshrq_n_u8(value1, 4));
+                    bytes.val[1] = vorrq_u8(vshlq_n_u8(value1, 4), vshrq_n_u8(value2, 2));
+                    bytes.val[2] = vorrq_u8(vshlq_n_u8(value2, 6), value3);
+                    if (vminvq_u8(valid) == 0xff) {
+                        vst3q_u8(data + written, bytes);
+                        in += 64;
+                        written += 48;
+                        continue;
+                    }
+
+                    // the groups before the first one with a character outside the alphabet are still taken
+                    uint8_t groupIsValid[16];
+                    uint8_t groupBytes[48];
+                    vst1q_u8(groupIsValid, valid);
+                    vst3q_u8(groupBytes, bytes);
+                    size_t groups = 0;
+                    while (groupIsValid[groups] == 0xff) {
+                        ++groups;
+                    }
+                    memcpy(data + written, groupBytes, groups * 3);
+                    in += groups * 4;
+                    written += groups * 3;
+                    if (!Base64IsLineBreak(str + in, size - in)) {
+                        return in;
+                    }
+                    in += 2;
+                }
+                return in;
+            }
+
+            inline Base64Kernels SelectBase64Kernels() {
+                return{ Base64EncodeNeon, Base64DecodeNeon };
+            }
+#else
+            inline Base64Kernels SelectBase64Kernels() {
+                return{ Base64EncodeScalar, Base64DecodeScalar };
+            }
+#endif
+
+            inline const Base64Kernels& GetBase64Kernels() {
+                static const Base64Kernels kernels = SelectBase64Kernels();
+                return kernels;
+            }
+
+        } // namespace detail
+
+        // Size of the text Base64Encode makes out of size bytes, line breaks included
+        inline size_t Base64EncodedSize(size_t size) {
+            if (size == 0) {
+                return 0;
+            }
             const size_t encodedSize = 4 * ((size + 2) / 3);
-            std::string str(encodedSize + 2 * ((encodedSize - 1) / lineLength), '\0');
+            return encodedSize + 2 * ((encodedSize - 1) / BASE_64_LINE_LENGTH);
+        }
+
+        // Writes Base64EncodedSize(size) characters to str, which must have room for them (no '\0' is added)
+        inline size_t Base64Encode(const char* data, size_t size, char* str) {
+            const detail::Base64Kernels& kernels = detail::GetBase64Kernels();
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+            const size_t lineSize = BASE_64_LINE_LENGTH / 4 * 3;
 
             size_t in = 0;
             size_t out = 0;
-            for (size_t wrap = lineLength; in + 3 <= size; in += 3, wrap -= 4) {
-                if (wrap == 0) {
+            while (in < size) {
+                if (in != 0) {
                     str[out++] = '\r';
                     str[out++] = '\n';
-                    wrap = lineLength;
                 }
-                str[out++] = Base64Char0(data[in]);
-                str[out++] = Base64Char1(data[in], data[in + 1]);
-                str[out++] = Base64Char2(data[in + 1], data[in + 2]);
-                str[out++] = Base64Char3(data[in + 2]);
-            }
 
-            if (in < size) {
-                str[out++] = Base64Char0(data[in]);
-                if (in + 1 < size) {
-                    str[out++] = Base64Char1(data[in], data[in + 1]);
-                    str[out++] = Base64Char2(data[in + 1], 0);
-                } else {
-                    str[out++] = Base64Char1(data[in], 0);
+                const size_t lineEnd = size - in > lineSize ? in + lineSize : size;
+                const size_t encoded = kernels.encode(bytes + in, lineEnd - in, size - in, str + out);
+                in += encoded;
+                out += encoded / 3 * 4;
+
+                for (; in + 3 <= lineEnd; in += 3) {
+                    str[out++] = Base64Char0(bytes[in]);
+                    str[out++] = Base64Char1(bytes[in], bytes[in + 1]);
+                    str[out++] = Base64Char2(bytes[in + 1], bytes[in + 2]);
+                    str[out++] = Base64Char3(bytes[in + 2]);
+                }
+
+                if (in < lineEnd) {
+                    str[out++] = Base64Char0(bytes[in]);
+                    if (in + 1 < lineEnd) {
+                        str[out++] = Base64Char1(bytes[in], bytes[in + 1]);
+                        str[out++] = Base64Char2(bytes[in + 1], 0);
+                    } else {
+                        str[out++] = Base64Char1(bytes[in], 0);
+                        str[out++] = '=';
+                    }
                     str[out++] = '=';
+                    in = lineEnd;
                 }
-                str[out++] = '=';
             }
 
-            assert(str.size() == out);
-            return str;
+            assert(Base64EncodedSize(size) == out);
+            return out;
         }
 
-        inline std::string Base64Decode(const std::string& str); // forward declaration
+        inline std::string Base64Encode(const std::string& data); // forward declaration
 
-        inline std::string Base64Decode(const char* str, size_t size) {
-            const size_t maxDecodedSize = 3 * ((size + 3) / 4);
+        inline std::string Base64Encode(const char* data, size_t size) {
+            std::string str(Base64EncodedSize(size), '\0');
+            Base64Encode(data, size, &str[0]);
+            return str;
+        }
 
-            std::string data(maxDecodedSize, '\0');
+        // Room Base64Decode needs for size characters; what it writes is usually a bit less
+        inline size_t Base64MaximumDecodedSize(size_t size) {
+            return 3 * ((size + 3) / 4);
+        }
+
+        // Writes the decoded bytes to data, which must have room for Base64MaximumDecodedSize(size) of them, and
+        // returns how many there are. Characters outside the alphabet (line breaks, padding) are skipped.
+        inline size_t Base64Decode(const char* str, size_t size, char* data) {
+            const detail::Base64Kernels& kernels = detail::GetBase64Kernels();
+            uint8_t* bytes = reinterpret_cast<uint8_t*>(data);
 
+            size_t in = 0;
             size_t out = 0;
             uint32_t bits = 0;
             size_t bitCount = 0;
 
-            for (size_t in = 0; in < size; ++in) {
-                const int value = BASE_64_LUT[static_cast<uint8_t>(str[in])];
-                if (value != -1) {
+            while (in < size) {
+                size_t written;
+                in += kernels.decode(str + in, size - in, bytes + out, written);
+                out += written;
+
+                // what stopped the kernel is skipped one character at a time, up to the start of the next group
+                bool skipped = false;
+                for (; in < size; ++in) {
+                    const int value = BASE_64_LUT[static_cast<uint8_t>(str[in])];
+                    if (value == -1) {
+                        skipped = true;
+                        continue;
+                    }
+                    if (skipped && bitCount == 0) {
+                        break;
+                    }
+
                     bits = (bits << 6) | value;
                     bitCount += 6;
                     if (bitCount == 24) {
-                        data[out++] = bits >> 16;
-                        data[out++] = bits >> 8;
-                        data[out++] = bits;
+                        bytes[out++] = static_cast<uint8_t>(bits >> 16);
+                        bytes[out++] = static_cast<uint8_t>(bits >> 8);
+                        bytes[out++] = static_cast<uint8_t>(bits);
 
                         bits = 0;
                         bitCount = 0;
@@ -169,13 +703,20 @@ namespace jsonrpc {
             if (bitCount >= 12) {
                 bits = bits >> (bitCount % 8);
                 if (bitCount == 18) {
-                    data[out++] = bits >> 8;
+                    bytes[out++] = static_cast<uint8_t>(bits >> 8);
                 }
-                data[out++] = bits;
+                bytes[out++] = static_cast<uint8_t>(bits);
             }
 
-            assert(data.size() >= out);
-            data.resize(out);
+            assert(Base64MaximumDecodedSize(size) >= out);
+            return out;
+        }
+
+        inline std::string Base64Decode(const std::string& str); // forward declaration
+
+        inline std::string Base64Decode(const char* str, size_t size) {
+            std::string data(Base64MaximumDecodedSize(size), '\0');
+            data.resize(Base64Decode(str, size, &data[0]));
             return data;
         }
 
@@ -22,12 +22,14 @@
 
 #include <cstdint>
 #include <iosfwd>
+#include <limits>
 #include <map>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <ostream>
 
+#include "flatobject.h"
 #include "util.h"
 #include "fault.h"
 #include "writer.h"
@@ -61,7 +63,13 @@ namespace jsonrpc {
         typedef double Double;
         typedef int Int32;
         typedef std::string String;
+        // With JSONRPC_LEAN_FLAT_OBJECT defined, objects keep their members in a vector (see FlatObject): no
+        // allocation per member, written in the order they were added, but adding one moves the others
+#ifdef JSONRPC_LEAN_FLAT_OBJECT
+        typedef FlatObject<Value> Object;
+#else
         typedef std::unordered_map<String, Value> Object;
+#endif
         typedef std::vector<Value> Array;
 
         static constexpr Undefined undefined = Undefined();
@@ -76,6 +84,11 @@ namespace jsonrpc {
             TYPE_DOUBLE = TYPE_NUMBER | 0x00,
             TYPE_INT32 = TYPE_NUMBER | 0x01,
             TYPE_STRING = 0x08,
+            // JSON text written out as it is (see RawJson), stored like a string
+            TYPE_RAW_JSON = TYPE_STRING | 0x01,
+            // A string of bytes rather than text, written with Writer::WriteBinary (0x02 and 0x04 would
+            // read as boolean and number bits)
+            TYPE_BINARY = TYPE_STRING | 0x20,
             TYPE_OBJECT = 0x10,
             TYPE_ARRAY = TYPE_OBJECT | 0x01,
 
@@ -111,13 +124,24 @@ namespace jsonrpc {
         // Construct with iterable (use ... to lower priority and let String/Object/Array match first)
         template<typename T, typename = std::enable_if_t<!is_passable<T, String, Object, Array>::value>, typename X = decltype(std::declval<T>().begin(), std::declval<T>().end(), true)> Value(T&& iterable, ...) : Value() { Construct(std::forward<T>(iterable)); }
         // Construct with iterator pair
-        template<typename T, typename U> Value(T&& first, U&& last) : Value() { Construct(std::forward<T>(first), std::forward<U>(last)); }
+        template<typename T, typename U, typename = std::enable_if_t<!std::is_same<std::decay_t<U>, bool>::value>> Value(T&& first, U&& last) : Value() { Construct(std::forward<T>(first), std::forward<U>(last)); }
 
         explicit Value(const Value& copy) : Value() { Assign(copy); }
         Value(Value&& move) noexcept : Value() { Assign(std::move(move)); }
 
 		~Value() { Unfreeze(); Reset(); }
 
+        // A value that is already JSON text (from a cache, a database column, another service...), written by
+        // JsonWriter without being parsed and encoded again. It must be exactly one JSON value, which is only
+        // checked in debug builds; other formats parse it to write what it holds.
+        static Value RawJson(String json)
+        {
+            Value value;
+            value._as.stringPointer = new String(std::move(json));
+            value._type = TYPE_RAW_JSON;
+            return value;
+        }
+
     private:
         Type SetType(Type type)
         {
@@ -170,7 +194,10 @@ namespace jsonrpc {
         bool IsNumber() const { return (GetType() & TYPE_NUMBER) != 0; }
         bool IsDouble() const { return GetType() == TYPE_DOUBLE; }
         bool IsInt32() const { return GetType() == TYPE_INT32; }
-        bool IsString() const { return GetType() == TYPE_STRING; }
+        // Binary values are strings too
+        bool IsString() const { return GetType() == TYPE_STRING || GetType() == TYPE_BINARY; }
+        bool IsBinary() const { return GetType() == TYPE_BINARY; }
+        bool IsRawJson() const { return GetType() == TYPE_RAW_JSON; }
         bool IsObject() const { return GetType() == TYPE_OBJECT; }
         bool IsArray() const { return GetType() == TYPE_ARRAY; }
 
@@ -199,8 +226,9 @@ namespace jsonrpc {
         const Double & AsDouble () const { return Check(IsDouble ()),  _as.doubleValue ; }
               Int32  & AsInt32  ()       { return Check(IsInt32  ()),  _as.int32Value  ; }
         const Int32  & AsInt32  () const { return Check(IsInt32  ()),  _as.int32Value  ; }
-              String & AsString ()       { return Check(IsString ()), *_as.stringPointer ; }
-        const String & AsString () const { return Check(IsString ()), *_as.stringPointer ; }
+              String & AsString ()       { return Check(IsString ()), *_as.stringPointer; }
+        const String & AsString () const { return Check(IsString ()), *_as.stringPointer; }
+        const String & AsRawJson() const { return Check(IsRawJson()), *_as.stringPointer; }
               Object & AsObject ()       { return Check(IsObject ()), *_as.objectPointer ; }
         const Object & AsObject () const { return Check(IsObject ()), *_as.objectPointer ; }
               Array  & AsArray  ()       { return Check(IsArray  ()), *_as.arrayPointer  ; }
@@ -220,7 +248,8 @@ namespace jsonrpc {
             case TYPE_INT32: return (Double)_as.int32Value;
             case TYPE_BOOLEAN: return _as.booleanValue ? 1.0 : 0.0;
             case TYPE_NULL: return 0.0;
-            case TYPE_STRING: return ParseDouble(*_as.stringPointer);
+            case TYPE_STRING:
+            case TYPE_BINARY: return ParseDouble(*_as.stringPointer);
             case TYPE_ARRAY: return _as.arrayPointer->size() == 0 ? 0.0 : _as.arrayPointer->size() == 1 ? (*_as.arrayPointer)[0].ToDouble() : NaN;
             default: return NaN;
             }
@@ -235,15 +264,26 @@ namespace jsonrpc {
         {
             switch (GetType())
             {
-            case TYPE_STRING: return *_as.stringPointer;
+            case TYPE_STRING:
+            case TYPE_BINARY:
+            case TYPE_RAW_JSON: return *_as.stringPointer;
             case TYPE_UNDEFINED: return "undefined";
             case TYPE_NULL: return "null";
             case TYPE_BOOLEAN: return _as.booleanValue ? "true" : "false";
             case TYPE_DOUBLE:
                 if (std::isnan(_as.doubleValue)) return "NaN";
                 else if (std::isinf(_as.doubleValue)) return _as.doubleValue < 0 ? "-Infinity" : "Infinity";
-                else return std::to_string(_as.doubleValue);
-            case TYPE_INT32: return std::to_string(_as.int32Value);
+                else
+                {
+                    // shortest text that reads back the same double
+                    char str[util::MAXIMUM_NUMBER_SIZE];
+                    return String(str, util::FormatDouble(_as.doubleValue, str));
+                }
+            case TYPE_INT32:
+            {
+                char str[util::MAXIMUM_NUMBER_SIZE];
+                return String(str, util::FormatInt32(_as.int32Value, str));
+            }
             case TYPE_ARRAY:
             {
                 std::string result;
@@ -261,7 +301,9 @@ namespace jsonrpc {
         }
         template<typename T> inline T ToType() const;
 
-        void Write(Writer& writer) const
+        // Templated on the writer so that writing through a final one (JsonWriter) binds every call statically
+        template<typename WriterType>
+        void Write(WriterType& writer) const
         {
             switch (GetType())
             {
@@ -271,6 +313,8 @@ namespace jsonrpc {
             case TYPE_DOUBLE: writer.Write(_as.doubleValue); break;
             case TYPE_INT32: writer.Write(_as.int32Value); break;
             case TYPE_STRING: writer.Write(*_as.stringPointer); break;
+            case TYPE_BINARY: writer.WriteBinary(_as.stringPointer->data(), _as.stringPointer->size()); break;
+            case TYPE_RAW_JSON: writer.WriteRawJson(_as.stringPointer->data(), _as.stringPointer->size()); break;
             case TYPE_OBJECT:
                 writer.StartStruct();
                 for (const auto& p : *_as.objectPointer)
@@ -308,7 +352,9 @@ namespace jsonrpc {
             case TYPE_BOOLEAN: return os << (value._as.booleanValue ? "true" : "false");
             case TYPE_DOUBLE: return os << value._as.doubleValue;
             case TYPE_INT32: return os << value._as.int32Value;
-            case TYPE_STRING: return os << '"' << *value._as.stringPointer << '"'; // FIXME: doesn't escape
+            case TYPE_STRING:
+            case TYPE_BINARY: return os << '"' << *value._as.stringPointer << '"'; // FIXME: doesn't escape
+            case TYPE_RAW_JSON: return os << *value._as.stringPointer;
             case TYPE_OBJECT:
                 os << '{';
                 for (auto& p : *value._as.objectPointer)
@@ -338,7 +384,7 @@ namespace jsonrpc {
 
     private:
         // Only worth having overloads to match actual instances of String/Object/Array, otherwise will have to create new instances anyway
-        template<typename T> Value& Assign(T&& value, std::enable_if_t<std::is_base_of<String, std::decay_t<T>>::value, void*> = 0) { if (IsString()) { *_as.stringPointer = std::forward<T>(value); return *this; } else return Reset(std::forward<T>(value)); }
+        template<typename T> Value& Assign(T&& value, std::enable_if_t<std::is_base_of<String, std::decay_t<T>>::value, void*> = 0) { if (GetType() == TYPE_STRING) { *_as.stringPointer = std::forward<T>(value); return *this; } else return Reset(std::forward<T>(value)); }
         template<typename T> Value& Assign(T&& value, std::enable_if_t<std::is_base_of<Object, std::decay_t<T>>::value, void*> = 0) { if (IsObject()) { *_as.objectPointer = std::forward<T>(value); return *this; } else return Reset(std::forward<T>(value)); }
         template<typename T> Value& Assign(T&& value, std::enable_if_t<std::is_base_of<Array , std::decay_t<T>>::value, void*> = 0) { if (IsArray ()) { *_as.arrayPointer  = std::forward<T>(value); return *this; } else return Reset(std::forward<T>(value)); }
 
@@ -351,7 +397,9 @@ namespace jsonrpc {
             {
                 switch (type)
                 {
-                case TYPE_STRING: *_as.stringPointer = *copy._as.stringPointer; break;
+                case TYPE_STRING:
+                case TYPE_BINARY:
+                case TYPE_RAW_JSON: *_as.stringPointer = *copy._as.stringPointer; break;
                 case TYPE_OBJECT: *_as.objectPointer = *copy._as.objectPointer; break;
                 case TYPE_ARRAY: *_as.arrayPointer = *copy._as.arrayPointer; break;
                 default: _as = copy._as; break;
@@ -364,7 +412,9 @@ namespace jsonrpc {
                 Reset();
                 switch (other)
                 {
-                case TYPE_STRING: _as.stringPointer = new String(*copy._as.stringPointer); break;
+                case TYPE_STRING:
+                case TYPE_BINARY:
+                case TYPE_RAW_JSON: _as.stringPointer = new String(*copy._as.stringPointer); break;
                 case TYPE_OBJECT: _as.objectPointer = new Object(*copy._as.objectPointer); break;
                 case TYPE_ARRAY: _as.arrayPointer = new Array(*copy._as.arrayPointer); break;
                 default: _as = copy._as; break;
@@ -385,7 +435,9 @@ namespace jsonrpc {
                 {
                     switch (type)
                     {
-                    case TYPE_STRING: *_as.stringPointer = std::move(*move._as.stringPointer); break;
+                    case TYPE_STRING:
+                    case TYPE_BINARY:
+                    case TYPE_RAW_JSON: *_as.stringPointer = std::move(*move._as.stringPointer); break;
                     case TYPE_OBJECT: *_as.objectPointer = std::move(*move._as.objectPointer); break;
                     case TYPE_ARRAY: *_as.arrayPointer = std::move(*move._as.arrayPointer); break;
                     default: _as = move._as; break;
@@ -413,7 +465,9 @@ namespace jsonrpc {
                 // Can swap underlying objects and leave the other side with empty remains
                 switch (type)
                 {
-                case TYPE_STRING: _as.stringPointer->clear(); break;
+                case TYPE_STRING:
+                case TYPE_BINARY:
+                case TYPE_RAW_JSON: _as.stringPointer->clear(); break;
                 case TYPE_OBJECT: _as.objectPointer->clear(); break;
                 case TYPE_ARRAY: _as.arrayPointer->clear(); break;
                 default: break;
@@ -440,7 +494,9 @@ namespace jsonrpc {
             case TYPE_BOOLEAN: return a._as.booleanValue == b._as.booleanValue;
             case TYPE_DOUBLE: return a._as.doubleValue == b._as.doubleValue;
             case TYPE_INT32: return a._as.int32Value == b._as.int32Value;
-            case TYPE_STRING: return *a._as.stringPointer == *b._as.stringPointer;
+            case TYPE_STRING:
+            case TYPE_BINARY:
+            case TYPE_RAW_JSON: return *a._as.stringPointer == *b._as.stringPointer;
             case TYPE_OBJECT: return *a._as.objectPointer == *b._as.objectPointer;
             case TYPE_ARRAY: return *a._as.arrayPointer == *b._as.arrayPointer;
             default: return true;
@@ -449,17 +505,17 @@ namespace jsonrpc {
         friend bool operator!=(const Value& a, const Value& b) { return !(a == b); }
 
 
-        static Double ParseDouble(const std::string& str) { return ParseDouble(str.c_str()); }
+        static Double ParseDouble(const std::string& str) { return str.empty() ? 0.0 : ParseDouble(str.data(), str.size()); }
         static Double ParseDouble(const char* str)
         {
             if (!str) return NaN;
             if (!*str) return 0.0;
-            char* end;
-            double result = std::strtod(str, &end);
-            if (end == str) return NaN;
-            while (std::isspace(*end)) ++end;
-            if (*end) return NaN;
-            return result;
+            return ParseDouble(str, strlen(str));
+        }
+        static Double ParseDouble(const char* str, size_t size)
+        {
+            double result;
+            return util::ParseDouble(str, size, result) ? result : NaN;
         }
         static Int32 ParseInt32(const std::string& str) { return ParseInt32(str.c_str()); }
         static Int32 ParseInt32(const char* str)
@@ -484,12 +540,9 @@ namespace jsonrpc {
         Value& Reset()
         {
             Type type = SetType(TYPE_UNDEFINED);
-            if (type & (TYPE_STRING | TYPE_OBJECT))
-            {
-                if (type == TYPE_STRING) delete _as.stringPointer;
-                else if (type == TYPE_OBJECT) delete _as.objectPointer;
-                else if (type == TYPE_ARRAY) delete _as.arrayPointer;
-            }
+            if (HasStringStorage(type)) delete _as.stringPointer;
+            else if (type == TYPE_OBJECT) delete _as.objectPointer;
+            else if (type == TYPE_ARRAY) delete _as.arrayPointer;
             return *this;
         }
 
@@ -511,13 +564,16 @@ namespace jsonrpc {
             constexpr Storage(double value) : doubleValue(value) {}
         } _as;
 
+        static bool HasStringStorage(Type type) { return type == TYPE_STRING || type == TYPE_BINARY || type == TYPE_RAW_JSON; }
+
 
     public:
         // JSONRPC-lean compatibility:
         typedef Object Struct;
         Struct& AsStruct() { return AsObject(); }
         const Struct& AsStruct() const { return AsObject(); }
-        Value(std::string value, bool) : Value(value) {}
+        Value(std::string value, bool binary) : Value(std::move(value)) { if (binary) _type = TYPE_BINARY; }
+        const String& AsBinary() const { return AsString(); }
         Value(int64_t value) : Value((double)value) {}
         bool IsInteger32() const { return IsInt32(); }
         bool IsInteger64() const { return false; }
@@ -526,6 +582,10 @@ namespace jsonrpc {
         int64_t AsInteger64() const { return Check(IsInteger64()), _as.int32Value; }
     };
 
+    // A tag and a pointer-sized union; an std::string kept inline would make every Value (and every element of
+    // arrays and requests) at least as large as the string object
+    static_assert(sizeof(Value) <= 16, "Value should stay a tag plus one pointer or double");
+
     template<> inline       Value::Boolean& Value::AsType<Value::Boolean>()       { return AsBoolean(); }
     template<> inline const Value::Boolean& Value::AsType<Value::Boolean>() const { return AsBoolean(); }
     template<> inline       Value::Double & Value::AsType<Value::Double >()       { return AsDouble (); }
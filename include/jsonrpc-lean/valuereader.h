@@ -0,0 +1,196 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_VALUEREADER_H
+#define JSONRPC_LEAN_VALUEREADER_H
+
+#include "reader.h"
+#include "fault.h"
+#include "json.h"
+#include "request.h"
+#include "response.h"
+#include "value.h"
+
+#include <cmath>
+#include <string>
+
+namespace jsonrpc {
+
+    // Base of the readers that decode the whole document into a Value first (JsonStreamReader, MsgPackReader):
+    // the requests and responses are then taken from myDocument, with their Values moved out of it.
+    class ValueReader : public Reader {
+    public:
+        // Reader
+        Request GetRequest() override {
+            return Detached(GetRequestView());
+        }
+
+        Request GetRequestView() override {
+            return GetRequest(myDocument);
+        }
+
+        bool IsBatch() override {
+            return myDocument.IsArray();
+        }
+
+        size_t GetBatchSize() override {
+            return myDocument.IsArray() ? myDocument.AsArray().size() : 0;
+        }
+
+        Request GetBatchRequest(size_t index) override {
+            return Detached(GetBatchRequestView(index));
+        }
+
+        Request GetBatchRequestView(size_t index) override {
+            if (index >= GetBatchSize()) {
+                throw InvalidRequestFault();
+            }
+            return GetRequest(myDocument.AsArray()[index]);
+        }
+
+        Response GetResponse() override {
+            return GetResponse(myDocument);
+        }
+
+        Response GetBatchResponse(size_t index) override {
+            if (index >= GetBatchSize()) {
+                throw InvalidRequestFault();
+            }
+            return GetResponse(myDocument.AsArray()[index]);
+        }
+
+        // Hands the whole document over, the reader is empty afterwards
+        Value GetValue() override {
+            return std::move(myDocument);
+        }
+
+    protected:
+        Value myDocument;
+
+    private:
+        static Request Detached(Request request) {
+            request.DetachParameters();
+            return request;
+        }
+
+        Response GetResponse(Value& node) const {
+            if (!node.IsObject()) {
+                throw InvalidRequestFault();
+            }
+
+            auto& response = node.AsObject();
+            ValidateJsonrpcVersion(response);
+
+            auto id = response.find(json::ID_NAME);
+            if (id == response.end()) {
+                throw InvalidRequestFault();
+            }
+
+            auto result = response.find(json::RESULT_NAME);
+            auto error = response.find(json::ERROR_NAME);
+
+            if (result != response.end()) {
+                if (error != response.end()) {
+                    throw InvalidRequestFault();
+                }
+                return Response(std::move(result->second), GetId(id->second));
+            } else if (error != response.end()) {
+                if (!error->second.IsObject()) {
+                    throw InvalidRequestFault();
+                }
+                auto& fault = error->second.AsObject();
+                auto code = fault.find(json::ERROR_CODE_NAME);
+                if (code == fault.end() || !code->second.IsInt32()) {
+                    throw InvalidRequestFault();
+                }
+                auto message = fault.find(json::ERROR_MESSAGE_NAME);
+                if (message == fault.end() || !message->second.IsString()) {
+                    throw InvalidRequestFault();
+                }
+
+                return Response(code->second.AsInt32(), std::move(message->second.AsString()),
+                    GetId(id->second));
+            } else {
+                throw InvalidRequestFault();
+            }
+        }
+
+        Request GetRequest(Value& node) const {
+            if (!node.IsObject()) {
+                throw InvalidRequestFault();
+            }
+
+            auto& request = node.AsObject();
+            ValidateJsonrpcVersion(request);
+
+            auto method = request.find(json::METHOD_NAME);
+            if (method == request.end() || !method->second.IsString()) {
+                throw InvalidRequestFault();
+            }
+
+            Request::Parameters parameters;
+            ValueView namedParameters;
+            auto params = request.find(json::PARAMS_NAME);
+            if (params != request.end()) {
+                if (params->second.IsObject()) {
+                    // by name, left in myDocument (which must outlive the request) for the method to put in order
+                    namedParameters = ValueView(params->second);
+                } else if (!params->second.IsArray()) {
+                    throw InvalidRequestFault();
+                } else {
+                    for (auto& param : params->second.AsArray()) {
+                        parameters.emplace_back(std::move(param));
+                    }
+                }
+            }
+
+            auto id = request.find(json::ID_NAME);
+            Value requestId = id == request.end() ? Value(false) : GetId(id->second); // false for a notification
+            if (!namedParameters.IsUndefined()) {
+                return Request(method->second.AsString(), namedParameters, std::move(requestId));
+            }
+            return Request(method->second.AsString(), std::move(parameters), std::move(requestId));
+        }
+
+        static void ValidateJsonrpcVersion(const Value::Object& object) {
+            auto jsonrpc = object.find(json::JSONRPC_NAME);
+            if (jsonrpc == object.end()
+                || !jsonrpc->second.IsString()
+                || jsonrpc->second.AsString() != json::JSONRPC_VERSION_2_0) {
+                throw InvalidRequestFault();
+            }
+        }
+
+        // Same ids as JsonReader accepts; 64 bit integers are doubles in a Value
+        static Value GetId(const Value& id) {
+            if (id.IsString() || id.IsInt32()) {
+                return Value(id);
+            } else if (id.IsDouble() && std::floor(id.AsDouble()) == id.AsDouble()) {
+                return Value(id);
+            } else if (id.IsUndefined()) {
+                // JSON null is read as undefined, as in JsonReader
+                return{};
+            }
+
+            throw InvalidRequestFault();
+        }
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_VALUEREADER_H
@@ -0,0 +1,256 @@
+// This file is part of jsonrpc-lean, a c++11 JSON-RPC client/server library.
+//
+// Copyright (C) 2015 Adriano Maia <tony@stark.im>
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef JSONRPC_LEAN_VALUEVIEW_H
+#define JSONRPC_LEAN_VALUEVIEW_H
+
+#include "compat.h"
+#include "value.h"
+
+#include <cstring>
+#include <deque>
+#include <string>
+
+namespace jsonrpc {
+
+    // Read-only view of a value that lives somewhere else, usually the document parsed by a Reader.
+    // Nothing is converted to a Value until it is accessed, so a handler reading a few fields out of
+    // a large struct never pays for the rest of it. A view is only valid as long as what it points to.
+    class ValueView {
+    public:
+        typedef void(*MemberCallback)(void* context, const char* name, size_t nameSize, const ValueView& value);
+
+        // Implemented once per kind of node (a parsed document, a Value tree...)
+        struct Accessor {
+            Value::Type(*GetType)(const void* node);
+            bool(*GetBoolean)(const void* node);
+            int32_t(*GetInt32)(const void* node);
+            double(*GetDouble)(const void* node);
+            const char*(*GetString)(const void* node, size_t& size);
+            size_t(*GetSize)(const void* node);
+            ValueView(*GetElement)(const void* node, size_t index);
+            ValueView(*FindMember)(const void* node, const char* name, size_t nameSize);
+            void(*ForEachMember)(const void* node, MemberCallback callback, void* context);
+            Value(*ToValue)(const void* node);
+        };
+
+        // Views of values that aren't stored together (e.g. named parameters, put in order), seen as an array
+        struct List {
+            const ValueView* views;
+            size_t size;
+        };
+
+        ValueView() : myNode(nullptr), myAccessor(nullptr) {}
+        ValueView(const void* node, const Accessor& accessor) : myNode(node), myAccessor(&accessor) {}
+
+        explicit ValueView(const Value& value) : ValueView(&value, GetValueAccessor()) {}
+        // Parameters of a Request (an std::deque<Value>) seen as an array
+        explicit ValueView(const std::deque<Value>& values) : ValueView(&values, GetDequeAccessor()) {}
+        // The list (and the views in it) must outlive the view
+        explicit ValueView(const List& list) : ValueView(&list, GetListAccessor()) {}
+
+        // Like the above, but ToValue() on the array or one of its elements moves out of values (leaving them
+        // undefined) instead of copying.
+        static ValueView TakeFrom(std::deque<Value>& values) { return ValueView(&values, GetMovableDequeAccessor()); }
+
+        // True for the elements of a TakeFrom view, whose ToValue() leaves them undefined
+        bool IsMovable() const { return myAccessor == &GetMovableValueAccessor(); }
+
+        Value::Type GetType() const { return myNode ? myAccessor->GetType(myNode) : Value::TYPE_UNDEFINED; }
+
+        bool IsUndefined() const { return GetType() == Value::TYPE_UNDEFINED; }
+        bool IsNull() const { return GetType() == Value::TYPE_NULL; }
+        bool IsBoolean() const { return GetType() == Value::TYPE_BOOLEAN; }
+        bool IsNumber() const { return (GetType() & Value::TYPE_NUMBER) != 0; }
+        bool IsDouble() const { return GetType() == Value::TYPE_DOUBLE; }
+        bool IsInt32() const { return GetType() == Value::TYPE_INT32; }
+        bool IsString() const { return GetType() == Value::TYPE_STRING || GetType() == Value::TYPE_BINARY; }
+        bool IsObject() const { return GetType() == Value::TYPE_OBJECT; }
+        bool IsArray() const { return GetType() == Value::TYPE_ARRAY; }
+
+        bool AsBoolean() const { return Value::Check(IsBoolean()), myAccessor->GetBoolean(myNode); }
+        int32_t AsInt32() const { return Value::Check(IsInt32()), myAccessor->GetInt32(myNode); }
+        double AsDouble() const { return Value::Check(IsDouble()), myAccessor->GetDouble(myNode); }
+        // Like Value::ToDouble() for numbers, without the string conversions
+        double ToDouble() const { return IsNumber() ? myAccessor->GetDouble(myNode) : Value::NaN; }
+
+        // Points into the viewed data, nothing is copied
+        const char* GetString(size_t& size) const {
+            Value::Check(IsString());
+            return myAccessor->GetString(myNode, size);
+        }
+
+        std::string AsString() const {
+            size_t size;
+            const char* data = GetString(size);
+            return std::string(data, size);
+        }
+
+#ifdef JSONRPC_LEAN_HAS_STRING_VIEW
+        std::string_view AsStringView() const {
+            size_t size;
+            const char* data = GetString(size);
+            return std::string_view(data, size);
+        }
+#endif
+
+        // Number of elements of an array or members of a struct, 0 for anything else
+        size_t Size() const { return IsArray() || IsObject() ? myAccessor->GetSize(myNode) : 0; }
+
+        ValueView operator[](size_t index) const {
+            Value::Check(IsArray() && index < myAccessor->GetSize(myNode));
+            return myAccessor->GetElement(myNode, index);
+        }
+
+        // Keeps view[0] from being ambiguous with the member lookup below
+        ValueView operator[](int index) const { return (*this)[static_cast<size_t>(index)]; }
+
+        // An undefined view is returned if there is no such member
+        ValueView operator[](const char* name) const { return FindMember(name, strlen(name)); }
+        ValueView operator[](const std::string& name) const { return FindMember(name.data(), name.size()); }
+
+        bool HasMember(const std::string& name) const { return !FindMember(name.data(), name.size()).IsUndefined(); }
+
+        // Calls callback(name, nameSize, value) for each member of a struct, in no particular order
+        template<typename Callback>
+        void ForEachMember(Callback callback) const {
+            Value::Check(IsObject());
+            myAccessor->ForEachMember(myNode, [](void* context, const char* name, size_t nameSize, const ValueView& value) {
+                (*static_cast<Callback*>(context))(name, nameSize, value);
+            }, &callback);
+        }
+
+        // Converts the viewed node (and everything below it) into a Value
+        Value ToValue() const { return myNode ? myAccessor->ToValue(myNode) : Value(); }
+
+    private:
+        ValueView FindMember(const char* name, size_t nameSize) const {
+            Value::Check(IsObject());
+            return myAccessor->FindMember(myNode, name, nameSize);
+        }
+
+        static const Value& AsValue(const void* node) { return *static_cast<const Value*>(node); }
+        static const std::deque<Value>& AsDeque(const void* node) { return *static_cast<const std::deque<Value>*>(node); }
+
+        static const Accessor& GetValueAccessor() {
+            static const Accessor accessor = {
+                [](const void* node) { return AsValue(node).GetType(); },
+                [](const void* node) { return AsValue(node).AsBoolean(); },
+                [](const void* node) { return static_cast<int32_t>(AsValue(node).AsInt32()); },
+                [](const void* node) { return AsValue(node).ToDouble(); },
+                [](const void* node, size_t& size) { auto& str = AsValue(node).AsString(); size = str.size(); return str.data(); },
+                [](const void* node) { return AsValue(node).IsArray() ? AsValue(node).AsArray().size() : AsValue(node).AsObject().size(); },
+                [](const void* node, size_t index) { return ValueView(AsValue(node).AsArray()[index]); },
+                [](const void* node, const char* name, size_t nameSize) {
+                    auto& object = AsValue(node).AsObject();
+#ifdef JSONRPC_LEAN_FLAT_OBJECT
+                    auto member = object.find(name, nameSize);
+#else
+                    auto member = object.find(std::string(name, nameSize));
+#endif
+                    return member == object.end() ? ValueView() : ValueView(member->second);
+                },
+                [](const void* node, MemberCallback callback, void* context) {
+                    for (auto& member : AsValue(node).AsObject()) {
+                        callback(context, member.first.data(), member.first.size(), ValueView(member.second));
+                    }
+                },
+                [](const void* node) { return Value(AsValue(node)); }
+            };
+            return accessor;
+        }
+
+        static const Accessor& GetDequeAccessor() {
+            static const Accessor accessor = {
+                [](const void*) { return Value::TYPE_ARRAY; },
+                [](const void*) { return false; },
+                [](const void*) { return int32_t(0); },
+                [](const void*) { return Value::NaN; },
+                [](const void*, size_t& size) { size = 0; return ""; },
+                [](const void* node) { return AsDeque(node).size(); },
+                [](const void* node, size_t index) { return ValueView(AsDeque(node)[index]); },
+                [](const void*, const char*, size_t) { return ValueView(); },
+                [](const void*, MemberCallback, void*) {},
+                [](const void* node) { return Value(AsDeque(node).begin(), AsDeque(node).end()); }
+            };
+            return accessor;
+        }
+
+        static const List& AsList(const void* node) { return *static_cast<const List*>(node); }
+
+        static const Accessor& GetListAccessor() {
+            static const Accessor accessor = {
+                [](const void*) { return Value::TYPE_ARRAY; },
+                [](const void*) { return false; },
+                [](const void*) { return int32_t(0); },
+                [](const void*) { return Value::NaN; },
+                [](const void*, size_t& size) { size = 0; return ""; },
+                [](const void* node) { return AsList(node).size; },
+                [](const void* node, size_t index) { return AsList(node).views[index]; },
+                [](const void*, const char*, size_t) { return ValueView(); },
+                [](const void*, MemberCallback, void*) {},
+                [](const void* node) {
+                    Value::Array array;
+                    array.reserve(AsList(node).size);
+                    for (size_t i = 0; i < AsList(node).size; ++i) {
+                        array.emplace_back(AsList(node).views[i].ToValue());
+                    }
+                    return Value(std::move(array));
+                }
+            };
+            return accessor;
+        }
+
+        // The node was given to TakeFrom as non-const, so casting it back to move from it is fine
+        static Value TakeValue(const void* node) {
+            return Value(std::move(const_cast<Value&>(AsValue(node))));
+        }
+
+        static const Accessor& GetMovableValueAccessor() {
+            static const Accessor accessor = [] {
+                Accessor movable = GetValueAccessor();
+                movable.ToValue = [](const void* node) { return TakeValue(node); };
+                return movable;
+            }();
+            return accessor;
+        }
+
+        static const Accessor& GetMovableDequeAccessor() {
+            static const Accessor accessor = [] {
+                Accessor movable = GetDequeAccessor();
+                movable.GetElement = [](const void* node, size_t index) { return ValueView(&AsDeque(node)[index], GetMovableValueAccessor()); };
+                movable.ToValue = [](const void* node) {
+                    Value::Array array;
+                    array.reserve(AsDeque(node).size());
+                    for (auto& value : AsDeque(node)) {
+                        array.emplace_back(TakeValue(&value));
+                    }
+                    return Value(std::move(array));
+                };
+                return movable;
+            }();
+            return accessor;
+        }
+
+        const void* myNode;
+        const Accessor* myAccessor;
+    };
+
+} // namespace jsonrpc
+
+#endif // JSONRPC_LEAN_VALUEVIEW_H
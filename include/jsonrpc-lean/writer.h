@@ -20,8 +20,10 @@
 #ifndef JSONRPC_LEAN_WRITER_H
 #define JSONRPC_LEAN_WRITER_H
 
+#include <cstdint>
 #include <string>
 #include <memory>
+#include "fault.h"
 #include "formatteddata.h"
 
 struct tm;
@@ -41,6 +43,14 @@ namespace jsonrpc {
         virtual void StartDocument() = 0;
         virtual void EndDocument() = 0;
 
+        // Batch; formats that have no batches keep these, which throw
+        virtual void StartBatch() {
+            throw InternalErrorFault("Internal error: batches are not supported by this format");
+        }
+        virtual void EndBatch() {
+            throw InternalErrorFault("Internal error: batches are not supported by this format");
+        }
+
         // Request
         virtual void StartRequest(const std::string& methodName,
             const Value& id) = 0;
@@ -70,6 +80,18 @@ namespace jsonrpc {
         virtual void Write(int64_t value) = 0;
         virtual void Write(const std::string& value) = 0;
         virtual void Write(const tm& value) = 0;
+        // One whole value already encoded in this writer's format, copied as it is (e.g. what a writer of the
+        // same kind made of that value alone). Formats that can't copy values keep this, which throws; results
+        // must then not be cached (see Dispatcher::SetCacheable).
+        virtual void WriteRaw(const char*, size_t) {
+            throw InternalErrorFault("Internal error: raw values are not supported by this format");
+        }
+
+        // One whole value as JSON text (see Value::RawJson), copied as it is by JsonWriter. Other formats keep this,
+        // which throws, or write what the text holds with ReplayRawJson (from rawjson.h, which needs rapidjson).
+        virtual void WriteRawJson(const char*, size_t) {
+            throw InternalErrorFault("Internal error: raw JSON values are not supported by this format");
+        }
     };
 
 } // namespace jsonrpc